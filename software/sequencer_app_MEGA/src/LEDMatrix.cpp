@@ -149,10 +149,12 @@ void LedMatrix::selectStep(int step) {
 
 //-----------------------------------------------------------------------------
 // Set the matrix state from the sequencer's step matrix for a given bar.
-// This copies 16 bytes from the sequencer into the local led_matrix array.
+// This copies the 16 steps of the bar into the local led_matrix array.
 void LedMatrix::setMatrixFromSequencer(byte bar) {
     visible_bar = bar;
-    memcpy(led_matrix, sequencerVar3->getStepMatrix() + bar * 16, 16);
+    for (int i = 0; i < 16; i++) {
+        led_matrix[i] = sequencerVar3->getStepOnOff(bar * 16 + i);
+    }
     int selected = sequencerVar3->getSelectedStep();
     if (selected < bar * 16 || selected >= (bar + 1) * 16) {
         selected_step_led = 16; // Invalid step index in current bar.
@@ -4,6 +4,7 @@
 #include "dac.h"
 #include "display.h"
 #include "encoder.h"
+#include "gestures.h"
 #include "LEDMatrix.h"
 #include "memory.h"
 #include "sequencer.h"
@@ -18,6 +19,7 @@ Buttons buttons;
 AnalogIo analogIo;
 Display display;
 Encoder encoder;
+Gestures gestures;
 LedMatrix ledMatrix;
 Memory memory;
 
@@ -26,45 +28,92 @@ Calibration *calibrationVar2;
 Sequencer *sequencerVar2;
 Dac *dacVar2;
 
-bool shift_state = false;
-bool load_button_state = false;
-bool save_button_state = false;
 bool record_mode = false;
 bool effect_mode = false;
 bool step_record_mode = false;
 bool saving = false;
-bool copy_state = false;
 bool encoder_bumped = false;
-byte erase_counter = 0;
-bool just_selected_param = false;
 bool mutate_on_reset_input = false;
+bool fill_mode = false;
+bool show_high_water = false; //calibration key 10 shows the button queue's drops, then its high-water mark
+bool matrix_stale = false; //step leds to be redrawn from the sequence after the current batch of events
+
+const unsigned int INPUT_BUDGET_US = 2000; //time per loop for queued button events, the rest wait for the next pass
+
+//ids of the function keys from the button map, the grid keys are 0-15
+const byte SHIFT_KEY = SHIFT_PIN + 8;
+const byte LOAD_KEY = LOAD_PIN + 8;
+const byte SAVE_KEY = SAVE_PIN + 8;
 
 const byte SEQUENCE_MODE = 0;
 const byte CALIBRATE_MODE = 1;
 const byte LOAD_MODE = 2;
 const byte SAVE_MODE = 3 ;
 const byte EDIT_PARAM_MODE = 4;
+const byte EUCLID_MODE = 5;
+const byte TRANSFORM_MODE = 6;
+const byte SONG_MODE = 7;
+const byte ARP_MODE = 8;
+const byte MOD_MODE = 9;
+
+//transforms picked with the first step keys in TRANSFORM_MODE
+const byte TRANSFORM_ROTATE = 0;
+const byte TRANSFORM_REVERSE = 1;
+const byte TRANSFORM_INVERT = 2;
+const byte TRANSFORM_DEGREE = 3; //in-scale transpose
+const byte TRANSFORM_FOLD = 4;
+const byte TRANSFORM_RESEED = 5; //new seed for the random/turing effects
 
+//fields of a song entry, stepped through with repeated presses in SONG_MODE
+const byte SONG_PATCH = 0;
+const byte SONG_REPEATS = 1;
+const byte SONG_TRANSPOSE = 2;
+
+//fields of a modulation route, stepped through with repeated presses in MOD_MODE
+const byte MOD_FIELD_SOURCE = 0;
+const byte MOD_FIELD_DESTINATION = 1;
+const byte MOD_FIELD_AMOUNT = 2;
+
+const byte PARAM_DIVISION = 5;
 const byte PARAM_TEMPO = 8;
 const byte PARAM_STEPS = 9;
 const byte PARAM_SCALE = 10;
 const byte PARAM_SWING = 11;
 const byte PARAM_TRANSPOSE = 12;
 const byte PARAM_SONG  = 15;
-const byte PARAM_LOOPS = 16; 
 const byte PARAM_EFFECT = 21;
 const byte PARAM_EFFECT_DEPTH = 25; //
 const byte PARAM_GLIDE = 26;
+const byte PARAM_PITCH_LENGTH = 30; //lane lengths follow in LANE_ order
+const byte PARAM_DURATION_LENGTH = 31;
+const byte PARAM_CV_LENGTH = 32;
+const byte PARAM_PROBABILITY = 33;
+const byte PARAM_CONDITION = 34;
 
 byte current_param = PARAM_TEMPO;
 byte ui_mode = SEQUENCE_MODE;
 byte calibration_step = 0;
 byte current_patch = 1;
 byte selected_patch = 1;
+byte queued_patch = 0; //waits for the switch boundary, 0 = none
 byte current_bar = 0;
+byte euclid_hits = 4;
+byte euclid_rotation = 0;
+bool euclid_whole_sequence = false;
+byte transform = TRANSFORM_ROTATE;
+byte song_field = SONG_PATCH;
+byte selected_entry = 0;
+byte song_page = 0; //16 song entries per page of step keys
+byte mod_field = MOD_FIELD_SOURCE;
+byte selected_route = 0;
+int8_t lock_step = -1; //step key held to lock the shown setting on that step
+int8_t hold_step = -1; //step key that turns its step off if held long enough
 char scalename[5];
 char effectname[5];
 char notename[5];
+char trigname[5];
+char arpname[5];
+char modname[5];
 
 
 void Ui::init(Calibration& calibration, Dac& dac, Sequencer& sequencer){
@@ -83,6 +132,8 @@ void Ui::init(Calibration& calibration, Dac& dac, Sequencer& sequencer){
     ledMatrix.init(display, sequencer);
 
 	analogIo.setDisplayMode(calibration.readDisplayModeValue());
+	int pickup_mode = calibration.readPickupMode();
+	analogIo.setPickupMode(pickup_mode < PICKUP_MODES ? pickup_mode : PICKUP_CATCH); //never set, EEPROM still erased
 
 
 	display.startupSequence();
@@ -98,26 +149,46 @@ void Ui::poll(){
 	if (saving) {
 		finishSaving();
 	}
-    buttons.poll();
+	memory.pollPrefetch();
+	//handle every pending event, up to the budget, then redraw once for the batch
+	unsigned long batch_start = micros();
 	uint16_t value = 0;
-	if (buttons.getQueuedEvent(value) == 0){
-        int button_pressed = value & 0x00FF; //use last 8 bits for button number
+	gesture g;
+	while (micros() - batch_start < INPUT_BUDGET_US && buttons.getQueuedEvent(value) == 0){
+        byte button_pressed = value & 0x00FF; //use last 8 bits for button number
 		bool button_state = (value & 0x0100) >> 8; // use first 8 bits (one of them anyway) for button state
-		onButtonToggle(button_pressed, button_state);
-        //buttons.button_toggled = false; // reset state for next poll
+		if (gestures.onKey(button_pressed, button_state, buttons.getEventTime(), g)) {
+			onButtonToggle(g);
+		}
     }
+	if (gestures.poll(micros(), g)) {
+		onLongPress(g);
+	}
 
-    int incrementAmount = encoder.poll();
+    int incrementAmount = encoder.poll(); //all detents since the last pass, one parameter update
     if (abs(incrementAmount) > 0) {
-        onEncoderIncrement(incrementAmount); //encoder.getIncrementAmount());
+        gestures.cancelLongPress(); //a key held to edit with the encoder isn't a long press
+        onEncoderIncrement(incrementAmount);
     }
 
+	if (matrix_stale) {
+		matrix_stale = false;
+		if (ui_mode != SONG_MODE && ui_mode != MOD_MODE && ui_mode != CALIBRATE_MODE) { //these show their own matrix
+			ledMatrix.setMatrixFromSequencer(current_bar);
+		}
+	}
+
+	if (ui_mode != MOD_MODE) {
+		sequencerVar2->writeModRoutes(); //mod mode left without cancelSaveOrLoad, e.g. by shift + a param key
+	}
+	analogIo.readModInputs(); //the cv inputs modulate in every mode, e.g. transposing the arp
 	if (ui_mode == SEQUENCE_MODE || ui_mode == EDIT_PARAM_MODE) {
-		analogIo.poll(shift_state);
+		analogIo.poll(shiftHeld());
 		//if (!record_mode) {
 		if (analogIo.paramChanged()){
+			gestures.cancelLongPress(); //nor is one held while a knob sets the step
 			displaySequenceParam();
-			cancelSaveOrLoad(); //TODO remove if this is too jittery to use
+			cancelSaveOrLoad();
 		}
 		//}
 	} else if (ui_mode == CALIBRATE_MODE) {
@@ -132,6 +203,11 @@ void Ui::poll(){
 	}
 }
 
+void Ui::refreshMatrix(){
+	//several events of a batch may each change the sequence, the leds follow once
+	matrix_stale = true;
+}
+
 void Ui::displaySequenceParam(){
 	if (analogIo.paramIsAlpha()) {
 		display.setDisplayAlphaVar(analogIo.getDisplayAlpha());
@@ -146,13 +222,25 @@ void Ui::multiplex(){
 }
 
 void Ui::onSaveButton(bool state) {
-	save_button_state = state;
+	if (state && shiftHeld() && ui_mode == SEQUENCE_MODE) { //shift + save = undo
+		undo(false);
+		return;
+	}
 	if (state) { //only toggle on input
 		if (ui_mode == CALIBRATE_MODE) {
 			ui_mode = SEQUENCE_MODE;
 			calibrationVar2->writeCalibrationValues();
 			digitalWrite(GATE_PIN, LOW);
 			initializeSequenceMode();
+		} else if (ui_mode == SONG_MODE) {
+			if (saving) return;
+			if (memory.saveSong()) { //the song has its own file, patches are left alone
+				saving = true;
+				display.setDisplayAlpha("SNG");
+				display.blinkDisplay(true, 100, 5);
+			} else {
+				display.setDisplayAlpha("ERR");
+			}
 		} else if (ui_mode == SAVE_MODE) {
 
 			//actually save the patch!!
@@ -186,12 +274,17 @@ void Ui::finishSaving(){
 
 
 void Ui::onLoadButton(bool state) {
-	load_button_state = state;
 	if (state) { //only toggle on input
 		if (saving) return;
 
 		if (ui_mode == LOAD_MODE) {
+			sequencerVar2->getSong().stop(); //a patch picked by hand leaves the song
+			if (sequencerVar2->getSwitchQuantize() != SWITCH_NOW && sequencerVar2->isRunning()) {
+				queuePatch(selected_patch);
+				return;
+			}
 			//actually load patch
+			cancelQueuedPatch();
 			if (memory.load(selected_patch)) {
 				display.blinkDisplay(true, 100, 3);
 			} else {
@@ -201,11 +294,11 @@ void Ui::onLoadButton(bool state) {
 			ui_mode = SEQUENCE_MODE;
 			current_patch = selected_patch;
 			current_bar = 0;
-			ledMatrix.setMatrixFromSequencer(current_bar);
+			refreshMatrix();
 			//TODO set sequencer current step by length of active sequence!
 		} else if (ui_mode == SEQUENCE_MODE){
-			if (shift_state) {
-				loadNextSequence();
+			if (shiftHeld()) { //shift + load = redo
+				undo(true);
 				return;
 			}
 			ui_mode = LOAD_MODE;
@@ -216,29 +309,38 @@ void Ui::onLoadButton(bool state) {
 	}
 }
 
-void Ui::onButtonToggle(int button, bool button_state) {
+void Ui::onButtonToggle(const gesture &g) {
+	int button = g.key;
+	bool button_state = g.type == GESTURE_PRESS;
 	if (button < 16) { //inside button grid
         //display.setDisplayNum(button);
         if (button_state) {
 			if (ui_mode == CALIBRATE_MODE) {
 				updateCalibration(button);
 			} else {
-				if (shift_state) {
-					shiftFunction(button);
-				} else if (load_button_state) {
+				if (shiftHeld()) {
+					shiftFunction(g);
+				} else if (gestures.isHeld(LOAD_KEY)) {
 					selected_patch = button + 1;
 					display.setDisplayNum(selected_patch);
-					onLoadButton(load_button_state);
-				} else if (save_button_state) {
+					onLoadButton(true);
+				} else if (gestures.isHeld(SAVE_KEY)) {
 					selected_patch = button + 1;
 					display.setDisplayNum(selected_patch);
-					onSaveButton(save_button_state);
+					onSaveButton(true);
 				} else {
 					selectStep(button);
 				}
 			}
         } else {
-			copy_state = false;
+			if (fill_mode && button == 4) holdFill(false); //fill lasts while its key is down, shift or not
+			sequencerVar2->setArpKey(button, false); //also after leaving ARP_MODE with keys still down
+			if (lock_step == button + current_bar*16) {
+				lock_step = -1;
+				display.setDecimal(false);
+				if (ui_mode == EDIT_PARAM_MODE) onEncoderIncrement(0); //back to the sequence setting
+			}
+			if (hold_step == button + current_bar*16) hold_step = -1;
 			//display.setDisplayNum(button*-1);
 		}
     } else {
@@ -256,48 +358,65 @@ void Ui::onButtonToggle(int button, bool button_state) {
     }
 }
 
+void Ui::onLongPress(const gesture &g){
+	//hold-to-deactivate: a step key held on an active step turns it off, without selecting it twice
+	if (ui_mode == SEQUENCE_MODE && !shiftHeld() && hold_step == g.key + current_bar*16) {
+		sequencerVar2->selectStep(hold_step); //already selected, so this toggles the gate
+		hold_step = -1;
+		display.blinkDisplay(true, 100, 1);
+		refreshMatrix();
+	}
+}
+
+bool Ui::shiftHeld(){
+	return gestures.isHeld(SHIFT_KEY);
+}
+
 void Ui::onShiftButton(bool button_state){
-	shift_state = button_state;
-	if (button_state) {
+	if (button_state && ui_mode != EUCLID_MODE && ui_mode != SONG_MODE && ui_mode != ARP_MODE) { //shift + encoder rotates the euclidean pattern or sets the arp range, shift + bar keys page through the song
 		cancelSaveOrLoad();
-	} else {
-		copy_state = false;
-		erase_counter = 0;
 	}
 }
 
-void Ui::shiftFunction(int button) {
+void Ui::shiftFunction(const gesture &g) {
+	int button = g.key;
 	if (button < 8) {
-		if (button < 4)	selectBar(button);
+		if (button < 4 && ui_mode == SONG_MODE) selectSongPage(button);
+		else if (button < 4) selectBar(button, g);
+		else if (button == 4) holdFill(true);
+		else if (button == 5) selectTrack();
+		else if (button == 6) selectTrigParam();
+		else if (button == 7) selectEuclid();
 	} else {
 		switch (button) {
-			case PARAM_SONG: 
-				ui_mode = EDIT_PARAM_MODE;
-				just_selected_param = true;
-				if (current_param == PARAM_SONG) {
-					current_param = PARAM_LOOPS;
-					display.setDisplayAlpha("LPS");
-				} else {
-					current_param = PARAM_SONG;
-					display.setDisplayAlpha("SNG");
-				}
-				break; 
+			case PARAM_SONG: selectSongMode(); break;
 			case 14: 
 				clearSequence();
-				erase_counter += 1;
-				switch (erase_counter) {
+				switch (g.taps) { //tapped in a row, the fifth tap erases the memory
 					case 2: display.setDisplayAlpha("E  "); break;
 					case 3: display.setDisplayAlpha("ER "); break;
 					case 4: display.setDisplayAlpha("ERS"); display.blinkDisplay(true, 500, 0); break;
-					case 5:  memory.erase(); display.setDisplayNum(0); erase_counter = 0; display.blinkDisplay(false, 100, 0); break;
+					case 5:  memory.erase(); display.setDisplayNum(0); display.blinkDisplay(false, 100, 0); break;
 				}
 				break;
 			case 13: initializeCalibrationMode(); break;
-			case PARAM_TEMPO: //select bars?
-			case PARAM_STEPS:
+			case PARAM_STEPS: selectLaneLength(); break;
+			case PARAM_TRANSPOSE:
+				if (ui_mode == EDIT_PARAM_MODE && current_param == PARAM_TRANSPOSE) { //second press while shift is held
+					selectTransformMode();
+					break;
+				} //otherwise falls through to the transpose param
 			case PARAM_SCALE:
+				if (button == PARAM_SCALE && ui_mode == EDIT_PARAM_MODE && current_param == PARAM_SCALE) { //second press while shift is held
+					selectArpMode();
+					break;
+				} //otherwise falls through to the scale param
+			case PARAM_TEMPO: //select bars?
 			case PARAM_SWING:
-			case PARAM_TRANSPOSE:
+				if (button == PARAM_SWING && ui_mode == EDIT_PARAM_MODE && current_param == PARAM_SWING) { //second press while shift is held
+					selectModMode();
+					break;
+				}
 			  ui_mode = EDIT_PARAM_MODE;
 			  current_param = button;
 			  onEncoderIncrement(0);
@@ -307,21 +426,47 @@ void Ui::shiftFunction(int button) {
 	}
 }
 
-void Ui::selectBar(byte bar){
-	if (copy_state) {
+byte Ui::lockParam(byte param){ //settings a step can lock, LOCK_PARAM_COUNT for any other
+	switch (param) {
+		case PARAM_TRANSPOSE: return LOCK_TRANSPOSE;
+		case PARAM_GLIDE: return LOCK_GLIDE;
+		case PARAM_EFFECT: return LOCK_EFFECT;
+		case PARAM_EFFECT_DEPTH: return LOCK_EFFECT_DEPTH;
+		case PARAM_SWING: return LOCK_SWING;
+	}
+	return LOCK_PARAM_COUNT;
+}
+
+void Ui::updateLock(int increment_amount){
+	//the decimal point shows the step plays its own value rather than the sequence setting
+	byte param = lockParam(current_param);
+	int value = sequencerVar2->incrementLock(lock_step, param, increment_amount);
+	if (param == LOCK_EFFECT) {
+		strcpy_P(effectname, (char *)pgm_read_word(&(effect_names[value])));
+		display.setDisplayAlpha(effectname);
+	} else {
+		display.setDisplayNum(value);
+	}
+	display.setDecimal(sequencerVar2->getLocked(lock_step, param));
+}
+
+void Ui::selectBar(byte bar, const gesture &g){
+	bar += current_bar & 4; //the bar keys stay on the shown half of the 8 bars
+	if (g.taps > 1) {
+		bar ^= 4; //a double tap flips to the other half
+	}
+	if (g.chord < 4) { //bar key held: the shown bar is pasted onto this one
 		sequencerVar2->paste(current_bar, bar);
 		display.setDisplayAlpha("CPY");
 		display.blinkDisplay(true, 100, 1);
-		copy_state = false;
 	} else {
 		char barname[4] = {char(36+55), char(11+55), char(bar+1+48)}; //goofy way of writing " b4" with ad-hoc ascii table conversion
 		display.setDisplayAlpha(barname);
-		copy_state = true;
 	}
 
 	current_bar = bar;
 	sequencerVar2->onBarSelect(current_bar);
-	ledMatrix.setMatrixFromSequencer(current_bar);
+	refreshMatrix();
 }
 
 //const char brightness_names[4][3] = {"---", "8--", "88-", "888"};
@@ -342,21 +487,56 @@ void Ui::onEncoderIncrement(int increment_amount) {
 			display.setDisplayNum(calibrationVar2->incrementCalibration(increment_amount, calibration_step));
     	    updateCalibration(calibration_step-1);
 		}
+	} else if (ui_mode == EUCLID_MODE) {
+		updateEuclid(increment_amount);
+	} else if (ui_mode == SONG_MODE) {
+		updateSongEntry(increment_amount);
+	} else if (ui_mode == ARP_MODE) {
+		updateArp(increment_amount);
+	} else if (ui_mode == MOD_MODE) {
+		updateModRoute(increment_amount);
+	} else if (ui_mode == TRANSFORM_MODE) {
+		if (transform == TRANSFORM_ROTATE) {
+			sequencerVar2->rotateSequence(increment_amount);
+		} else if (transform == TRANSFORM_DEGREE) {
+			memory.cancelPrefetch(); //a long pattern's undo snapshot goes in the shadow bank, as for a clear
+			sequencerVar2->transposeInScale(increment_amount);
+		}
+		refreshMatrix();
 	} else if (encoder_bumped || ui_mode == SAVE_MODE || ui_mode == LOAD_MODE) {
 		if (ui_mode == SEQUENCE_MODE) ui_mode = LOAD_MODE;
-		selected_patch += increment_amount;
-		if (selected_patch < 1) selected_patch = 99;
-		if (selected_patch > 99) selected_patch = 1;
+		int patch = selected_patch - 1 + encoder.accelerate(increment_amount); //faster turns skip through the 99 patches
+		selected_patch = (patch % 99 + 99) % 99 + 1; //wraps around either end
 		display.setDisplayNum(selected_patch);
 		display.setDecimal(memory.patchExists(selected_patch));
 		display.blinkDisplay(true, 300, 0);
 	} else if (ui_mode == EDIT_PARAM_MODE) {
 		int param = 0;
 		encoder_bumped = false;
-		if (current_param == PARAM_SCALE) {
+		if (lock_step >= 0) {
+			updateLock(increment_amount);
+		} else if (current_param == PARAM_SCALE) {
 			param = sequencerVar2->incrementScale(increment_amount);
 			strcpy_P(scalename, (char *)pgm_read_word(&(scale_names[param])));  // Necessary casts and dereferencing, just copy (for PROGMEM keywords in flash)
 			display.setDisplayAlpha(scalename);
+		} else if (current_param == PARAM_DIVISION) {
+			param = sequencerVar2->incrementDivision(increment_amount);
+			if (param == 0) {
+				display.setDisplayAlpha("OFF"); //second track off, DAC channel 1 plays CV2 again
+			} else {
+				display.setDisplayNum(param);
+			}
+		} else if (current_param >= PARAM_PITCH_LENGTH && current_param <= PARAM_CV_LENGTH) {
+			param = sequencerVar2->incrementLaneLength(current_param - PARAM_PITCH_LENGTH, increment_amount);
+			if (param == 0) {
+				display.setDisplayAlpha("LNK"); //lane linked to the step count
+			} else {
+				display.setDisplayNum(param);
+			}
+		} else if (current_param == PARAM_CONDITION) {
+			param = sequencerVar2->incrementCondition(increment_amount);
+			strcpy_P(trigname, (char *)pgm_read_word(&(trig_names[param])));
+			display.setDisplayAlpha(trigname);
 		} else if (current_param == PARAM_EFFECT) {
 			param = sequencerVar2->incrementEffect(increment_amount);
 			strcpy_P(effectname, (char *)pgm_read_word(&(effect_names[param])));  // Necessary casts and dereferencing, just copy (for PROGMEM keywords in flash)
@@ -364,21 +544,16 @@ void Ui::onEncoderIncrement(int increment_amount) {
 		} else {
 			switch(current_param) {
 				case PARAM_EFFECT_DEPTH: param = sequencerVar2->incrementEffectDepth(increment_amount); break;
-				case PARAM_TEMPO: param = sequencerVar2->incrementTempo(increment_amount); break; //sequencerVar2->incrementBars(increment_amount); break;
-				case PARAM_STEPS: param = sequencerVar2->incrementSteps(increment_amount, shift_state); break;
+				case PARAM_TEMPO: param = sequencerVar2->incrementTempo(encoder.accelerate(increment_amount)); break; //sequencerVar2->incrementBars(increment_amount); break;
+				case PARAM_STEPS: param = sequencerVar2->incrementSteps(increment_amount, shiftHeld()); break;
 				case PARAM_SWING: param = sequencerVar2->incrementSwing(increment_amount); break;
 				case PARAM_GLIDE: param = sequencerVar2->incrementGlide(increment_amount); break;
 				case PARAM_TRANSPOSE: param = sequencerVar2->incrementTranspose(increment_amount); break;
-				case PARAM_LOOPS: param = sequencerVar2->incrementSongLoops(just_selected_param ? 0 : increment_amount); just_selected_param = false; break;
-				case PARAM_SONG:  
-					param = sequencerVar2->incrementSongNextSeq(just_selected_param ? 0 : increment_amount);
-					just_selected_param = false;
-					display.setDecimal(memory.patchExists(param));
-					break;
+				case PARAM_PROBABILITY: param = sequencerVar2->incrementProbability(increment_amount); break;
 			}
 			display.setDisplayNum(param);
 		}
-	} else if (shift_state) {
+	} else if (shiftHeld()) {
 		sequencerVar2->incrementClock(increment_amount);
 	} else {
 		//by default when encoder is turned
@@ -391,7 +566,7 @@ void Ui::onEncoderIncrement(int increment_amount) {
 
 void Ui::onGlideButton(bool state){
 	if (state) {
-		if (shift_state) {
+		if (shiftHeld()) {
 			ui_mode = EDIT_PARAM_MODE;
 			current_param = PARAM_GLIDE;
 			onEncoderIncrement(0);
@@ -412,23 +587,23 @@ void Ui::invertEncoder(){
 }
 
 void Ui::onPlayButton(bool state){
-	if (state && shift_state) {
+	if (state && shiftHeld()) {
 		ledMatrix.reset();
-		ledMatrix.setMatrixFromSequencer(current_bar);
+		refreshMatrix();
 		sequencerVar2->onReset();
 		return;
 	}
 	if (state && isSequencing()) {
 		cancelSaveOrLoad();
 		ledMatrix.reset();
-		ledMatrix.setMatrixFromSequencer(current_bar);
+		refreshMatrix();
 		sequencerVar2->onPlayButton();
 	}
 }
 
 void Ui::onRecButton(bool state){
 	if (isSequencing()){
-		if (shift_state || step_record_mode) {
+		if (shiftHeld() || step_record_mode) {
 			//activate current step
 			sequencerVar2->setStepRecordingMode(state);
 			step_record_mode = state;
@@ -443,7 +618,7 @@ void Ui::onRecButton(bool state){
 
 void Ui::onRepeatButton(bool state){
 	if (isSequencing()){
-		if (shift_state) {
+		if (shiftHeld()) {
 			ui_mode = EDIT_PARAM_MODE;
 			current_param = PARAM_EFFECT;
 			onEncoderIncrement(0);
@@ -464,10 +639,32 @@ void Ui::onRepeatButton(bool state){
 }
 
 void Ui::selectStep(int step){
+	if (ui_mode == EUCLID_MODE) { //a step key only leaves the generator, so it can't flip a freshly generated step
+		cancelSaveOrLoad();
+		return;
+	} else if (ui_mode == TRANSFORM_MODE) {
+		selectTransform(step);
+		return;
+	} else if (ui_mode == SONG_MODE) {
+		selectSongEntry(step + song_page*16);
+		return;
+	} else if (ui_mode == ARP_MODE) {
+		sequencerVar2->setArpKey(step, true); //step keys are scale degrees from the root, whatever bar is shown
+		return;
+	} else if (ui_mode == MOD_MODE) {
+		selectModRoute(step);
+		return;
+	} else if (ui_mode == EDIT_PARAM_MODE && lockParam(current_param) < LOCK_PARAM_COUNT) {
+		lock_step = step + current_bar*16; //held step keys lock the shown setting instead of leaving it
+		updateLock(0);
+		return;
+	}
 	cancelSaveOrLoad();
+	bool was_on = sequencerVar2->getStepOnOff(step+current_bar*16);
 	sequencerVar2->selectStep(step+current_bar*16);
+	hold_step = was_on && sequencerVar2->getStepOnOff(step+current_bar*16) ? step+current_bar*16 : -1; //only selected, holding on turns it off
 	if (ui_mode == SEQUENCE_MODE) {
-		ledMatrix.setMatrixFromSequencer(current_bar);
+		refreshMatrix();
 	}
 	//ledMatrix.blinkLed();
     analogIo.displaySelectedParam();
@@ -475,7 +672,7 @@ void Ui::selectStep(int step){
 	buttons.setGlideLed(sequencerVar2->getGlide());
 }
 
-bool calibration_matrix[16] = {1,1,1,1, 1,1,1,1, 1,0,1,0, 1,0,1,1};
+bool calibration_matrix[16] = {1,1,1,1, 1,1,1,1, 1,1,1,1, 1,1,1,1};
 
 void Ui::initializeCalibrationMode() {
 	cancelSaveOrLoad();
@@ -489,9 +686,191 @@ void Ui::initializeCalibrationMode() {
 
 void Ui::clearSequence(){
 	display.setDisplayAlpha("CLR");
+	memory.cancelPrefetch(); //the shadow bank takes the undo snapshot, a prefetch starts again on the next step
 	sequencerVar2->clearSequence();
 	current_bar = 0;
-	ledMatrix.setMatrixFromSequencer(current_bar);
+	refreshMatrix();
+}
+
+void Ui::selectTrack(){
+	//step keys, pots and sequence params follow the selected track, the encoder sets its clock division
+	char trackname[4] = {'T', 'R', char(sequencerVar2->selectNextTrack()+1+48)};
+	display.setDisplayAlpha(trackname);
+	ui_mode = EDIT_PARAM_MODE;
+	current_param = PARAM_DIVISION;
+	refreshMatrix();
+	buttons.setGlideLed(sequencerVar2->getGlide());
+}
+
+void Ui::selectLaneLength(){
+	//repeated presses step from the sequence length through the pitch, duration and cv lane lengths
+	ui_mode = EDIT_PARAM_MODE;
+	switch (current_param) {
+		case PARAM_STEPS: current_param = PARAM_PITCH_LENGTH; display.setDisplayAlpha("PIT"); break;
+		case PARAM_PITCH_LENGTH: current_param = PARAM_DURATION_LENGTH; display.setDisplayAlpha("DUR"); break;
+		case PARAM_DURATION_LENGTH: current_param = PARAM_CV_LENGTH; display.setDisplayAlpha("CV "); break;
+		default:
+			current_param = PARAM_STEPS;
+			onEncoderIncrement(0);
+	}
+}
+
+void Ui::selectTrigParam(){
+	//probability and trig condition of the selected step, pressing again toggles between them
+	ui_mode = EDIT_PARAM_MODE;
+	if (current_param == PARAM_PROBABILITY) {
+		current_param = PARAM_CONDITION;
+		display.setDisplayAlpha("CND");
+	} else {
+		current_param = PARAM_PROBABILITY;
+		display.setDisplayAlpha("PRB");
+	}
+}
+
+void Ui::selectEuclid(){
+	//the encoder then writes euclidean rhythms over the current bar, pressing again switches to the whole sequence
+	if (ui_mode == EUCLID_MODE) {
+		euclid_whole_sequence = !euclid_whole_sequence;
+		display.setDisplayAlpha(euclid_whole_sequence ? "ALL" : "BAR");
+	} else {
+		cancelSaveOrLoad();
+		ui_mode = EUCLID_MODE;
+		display.setDisplayAlpha("EUC");
+	}
+}
+
+void Ui::updateEuclid(int increment_amount){
+	//encoder sets the number of hits, shift + encoder the rotation
+	byte sequence_length = sequencerVar2->getActiveSequence().sequence_length;
+	byte first_step = euclid_whole_sequence ? 0 : current_bar * 16;
+	byte steps = 16;
+	if (euclid_whole_sequence) {
+		steps = sequence_length;
+	} else if (sequence_length > first_step && sequence_length - first_step < 16) {
+		steps = sequence_length - first_step; //last, partial bar of the sequence
+	}
+
+	int rotation = euclid_rotation + (shiftHeld() ? increment_amount : 0);
+	while (rotation < 0) rotation += steps;
+	while (rotation >= steps) rotation -= steps;
+	euclid_rotation = rotation;
+	euclid_hits = min(max(euclid_hits + (shiftHeld() ? 0 : increment_amount), 0), steps);
+	display.setDisplayNum(shiftHeld() ? euclid_rotation : euclid_hits);
+
+	if (euclid_whole_sequence) memory.cancelPrefetch(); //a long fill is undone from a snapshot in the shadow bank
+	sequencerVar2->fillEuclid(first_step, steps, euclid_hits, euclid_rotation);
+	refreshMatrix();
+}
+
+void Ui::selectTransformMode(){
+	//whole-sequence transforms, picked with step keys 1-5. the selected step is the pivot for invert and fold
+	ui_mode = TRANSFORM_MODE;
+	transform = TRANSFORM_ROTATE;
+	display.setDisplayAlpha("ROT");
+}
+
+void Ui::selectTransform(int button){
+	//rotate and degree transpose follow the encoder, the others apply once per key press.
+	//invert and fold may keep their undo snapshot in the shadow bank, so a prefetch is dropped first
+	switch (button) {
+		case TRANSFORM_ROTATE: display.setDisplayAlpha("ROT"); break;
+		case TRANSFORM_REVERSE: sequencerVar2->reverseSequence(); display.setDisplayAlpha("REV"); break;
+		case TRANSFORM_INVERT: memory.cancelPrefetch(); sequencerVar2->invertPitches(); display.setDisplayAlpha("INV"); break;
+		case TRANSFORM_DEGREE: display.setDisplayAlpha("DEG"); break;
+		case TRANSFORM_FOLD: memory.cancelPrefetch(); sequencerVar2->foldOctaves(); display.setDisplayAlpha("FLD"); break;
+		case TRANSFORM_RESEED: reseedRandom(); return;
+		default: return;
+	}
+	transform = button;
+	display.blinkDisplay(true, 100, 1);
+	refreshMatrix();
+}
+
+void Ui::holdFill(bool state){
+	fill_mode = state;
+	sequencerVar2->setFill(state);
+	if (state) display.setDisplayAlpha("FIL");
+}
+
+void Ui::undo(bool redo){
+	if (redo ? sequencerVar2->redo() : sequencerVar2->undo()) {
+		display.setDisplayAlpha(redo ? "RED" : "UND");
+		display.blinkDisplay(true, 100, 1);
+	} else {
+		display.setDisplayAlpha("END"); //nothing left in the history
+	}
+	refreshMatrix();
+}
+
+void Ui::selectArpMode(){
+	//held step keys play as an arpeggio on the selected track. the encoder picks the order, shift + encoder the octave range
+	ui_mode = ARP_MODE;
+	display.setDisplayAlpha("ARP");
+}
+
+void Ui::updateArp(int increment_amount){
+	if (shiftHeld()) {
+		display.setDisplayNum(sequencerVar2->incrementArpOctaves(increment_amount));
+	} else {
+		strcpy_P(arpname, (char *)pgm_read_word(&(arp_names[sequencerVar2->incrementArpMode(increment_amount)])));
+		display.setDisplayAlpha(arpname);
+	}
+}
+
+void Ui::selectModMode(){
+	//routes from the cv inputs, one per step key 1-4. the encoder edits the last one pressed, pressing again steps through its fields
+	cancelSaveOrLoad();
+	ui_mode = MOD_MODE;
+	mod_field = MOD_FIELD_SOURCE;
+	display.setDisplayAlpha("MOD");
+	showModRoutes();
+}
+
+void Ui::selectModRoute(byte route){
+	if (route >= MOD_ROUTES) return;
+	if (route == selected_route) {
+		mod_field = mod_field == MOD_FIELD_AMOUNT ? MOD_FIELD_SOURCE : mod_field + 1;
+	} else {
+		selected_route = route;
+		mod_field = MOD_FIELD_SOURCE;
+	}
+	updateModRoute(0);
+}
+
+void Ui::updateModRoute(int increment_amount){
+	int value = 0;
+	switch (mod_field) {
+		case MOD_FIELD_SOURCE:
+			value = sequencerVar2->incrementModSource(selected_route, increment_amount);
+			strcpy_P(modname, (char *)pgm_read_word(&(mod_source_names[value])));
+			display.setDisplayAlpha(modname);
+			break;
+		case MOD_FIELD_DESTINATION:
+			value = sequencerVar2->incrementModDestination(selected_route, increment_amount);
+			strcpy_P(modname, (char *)pgm_read_word(&(mod_destination_names[value])));
+			display.setDisplayAlpha(modname);
+			break;
+		case MOD_FIELD_AMOUNT:
+			display.setDisplayNum(sequencerVar2->incrementModAmount(selected_route, increment_amount));
+			break;
+	}
+	showModRoutes();
+}
+
+void Ui::showModRoutes(){
+	//routes with a source light up
+	bool mod_matrix[16] = { 0 };
+	for (byte i = 0; i < MOD_ROUTES; i++) {
+		mod_matrix[i] = sequencerVar2->getModSource(i) != MOD_OFF;
+	}
+	ledMatrix.setMatrix(mod_matrix);
+	ledMatrix.selectStep(selected_route);
+}
+
+void Ui::reseedRandom(){
+	sequencerVar2->reseedRandom();
+	display.setDisplayAlpha("SED");
+	display.blinkDisplay(true, 100, 3);
 }
 
 void Ui::updateCalibration(int step) {
@@ -526,6 +905,38 @@ void Ui::updateCalibration(int step) {
 		}
 	}
 
+	if (step == 11) { //where patches picked while playing take over
+		calibration_step = step+1;
+		switch (sequencerVar2->cycleSwitchQuantize()) {
+			case SWITCH_NOW: display.setDisplayAlpha("NOW"); break;
+			case SWITCH_BAR: display.setDisplayAlpha("BAR"); break;
+			case SWITCH_4_BARS: display.setDisplayAlpha("4BR"); break;
+			case SWITCH_PATTERN: display.setDisplayAlpha("END"); break;
+		}
+	}
+
+	if (step == 13) { //what knobs do to values they don't match yet
+		calibration_step = step+1;
+		int pickup_mode = (analogIo.getPickupMode() + 1) % PICKUP_MODES;
+		analogIo.setPickupMode(pickup_mode);
+		calibrationVar2->writePickupMode(pickup_mode);
+		switch (pickup_mode) {
+			case PICKUP_JUMP: display.setDisplayAlpha("JMP"); break;
+			case PICKUP_CATCH: display.setDisplayAlpha("CAT"); break;
+			case PICKUP_SCALE: display.setDisplayAlpha("SCL"); break;
+		}
+	}
+
+	if (step == 9) { //button queue health, presses alternate between events dropped and the most ever waiting
+		char stats[4] = {show_high_water ? 'H' : 'D'};
+		byte value = show_high_water ? buttons.getQueueHighWater() : min(buttons.getDroppedEvents(), 99);
+		stats[1] = '0' + value / 10;
+		stats[2] = '0' + value % 10;
+		display.setDisplayAlphaVar(stats);
+		show_high_water = !show_high_water;
+		return;
+	}
+
 	if (step == 8) { // brightness
 		calibration_step = step+1;
 		display.setDisplayAlpha("BRT");
@@ -550,47 +961,179 @@ bool Ui::isSequencing(){
 void Ui::initializeSequenceMode(){
 	ui_mode = SEQUENCE_MODE;
 	ledMatrix.reset();
-	ledMatrix.setMatrixFromSequencer(current_bar);
+	refreshMatrix();
 	analogIo.displaySelectedParam();
 	displaySequenceParam();
 }
 
 void Ui::onStepIncremented(){
 	if (sequencerVar2->timeForNextSequence()) {
-		loadNextSequence();
+		if (queued_patch) {
+			loadQueuedPatch();
+		} else {
+			loadNextSequence();
+		}
+	} else if (sequencerVar2->songOnLastLoop()) { //read the next patch in the background so the switch doesn't stall
+		Song &song = sequencerVar2->getSong();
+		memory.prefetch(song.entry(song.getNext()).patch);
+	} else if (queued_patch) {
+		memory.prefetch(queued_patch); //again, in case a save held it off when it was queued
 	}
 
-	ledMatrix.setMatrixFromSequencer(current_bar);
-	ledMatrix.blinkCurrentStep();
+	if (ui_mode == SONG_MODE) {
+		showSongEntries();
+	} else if (ui_mode == MOD_MODE) { //keeps the route leds, as in Ui::poll
+		showModRoutes();
+	} else {
+		ledMatrix.setMatrixFromSequencer(current_bar);
+		ledMatrix.blinkCurrentStep();
+	}
 	if (record_mode) {
 		analogIo.recordCurrentParam();
 	}
 	sequencerVar2->setActiveNote(); //takes place here to enable real-time recording to be heard immediately
 }
 
+void Ui::queuePatch(byte patch){
+	//read in the background, the display blinks the patch number until it takes over
+	queued_patch = patch;
+	memory.prefetch(patch);
+	sequencerVar2->queueSequenceSwitch();
+	ui_mode = SEQUENCE_MODE;
+	display.setDisplayNum(queued_patch);
+	display.blinkDisplay(true, 300, 0);
+}
+
+void Ui::cancelQueuedPatch(){
+	queued_patch = 0;
+	sequencerVar2->cancelSequenceSwitch();
+}
+
+void Ui::loadQueuedPatch(){
+	byte patch = queued_patch;
+	queued_patch = 0;
+	if (memory.takePrefetched(patch) || memory.load(patch)) {
+		display.blinkDisplay(true, 100, 3);
+	} else {
+		sequencerVar2->clearSequence();
+		display.blinkDisplay(false, 100, 1);
+	}
+	current_patch = patch;
+	display.setDisplayNum(current_patch);
+	current_bar = 0;
+	refreshMatrix();
+}
+
 void Ui::loadNextSequence(){
-	int next_seq = sequencerVar2->getSongNextSeq();
-	if (next_seq > 0 && memory.patchExists(next_seq)) {
-		current_patch = next_seq;
+	Song &song = sequencerVar2->getSong();
+	if (song.getLength() == 0) { //emptied while playing
+		song.stop();
+		return;
+	}
+	playSongEntry(song.getNext());
+}
+
+void Ui::playSongEntry(byte entry){
+	//the display shows the song position, an entry whose patch is missing keeps the current patch playing
+	cancelQueuedPatch();
+	byte patch = sequencerVar2->getSong().entry(entry).patch;
+	if (memory.takePrefetched(patch) || memory.load(patch)) {
+		current_patch = patch;
 		selected_patch = current_patch;
-		memory.load(next_seq);
-		display.setDisplayNum(current_patch);
-		display.blinkDisplay(true, 100, 5);
 	}
+	sequencerVar2->getSong().start(entry);
+	display.setDisplayNum(entry + 1);
+	display.blinkDisplay(true, 100, 5);
+	if (ui_mode == SONG_MODE) {
+		showSongEntries();
+	} else {
+		refreshMatrix();
+	}
+}
+
+void Ui::selectSongMode(){
+	//step keys jump to song entries, the encoder edits the last one pressed. pressing again steps through its fields
+	if (ui_mode == SONG_MODE) {
+		song_field = song_field == SONG_TRANSPOSE ? SONG_PATCH : song_field + 1;
+	} else {
+		cancelSaveOrLoad();
+		ui_mode = SONG_MODE;
+		song_field = SONG_PATCH;
+		Song &song = sequencerVar2->getSong();
+		selected_entry = song.isPlaying() ? song.getPosition() : 0;
+		song_page = selected_entry / 16;
+	}
+	switch (song_field) {
+		case SONG_PATCH: display.setDisplayAlpha("PAT"); break;
+		case SONG_REPEATS: display.setDisplayAlpha("RPT"); break;
+		case SONG_TRANSPOSE: display.setDisplayAlpha("TRN"); break;
+	}
+	showSongEntries();
+}
+
+void Ui::selectSongPage(byte page){
+	song_page = page;
+	char pagename[4] = {'P', 'G', char(page+1+48)};
+	display.setDisplayAlpha(pagename);
+	showSongEntries();
+}
+
+void Ui::selectSongEntry(byte entry){
+	//entries past the end can't be played yet, the first of them is where the song grows
+	byte length = sequencerVar2->getSong().getLength();
+	selected_entry = min(entry, length);
+	if (selected_entry < length) {
+		playSongEntry(selected_entry);
+	} else {
+		updateSongEntry(0);
+	}
+}
+
+void Ui::updateSongEntry(int increment_amount){
+	Song &song = sequencerVar2->getSong();
+	int value = 0;
+	switch (song_field) {
+		case SONG_REPEATS: value = song.incrementRepeats(selected_entry, increment_amount); break;
+		case SONG_TRANSPOSE: value = song.incrementTranspose(selected_entry, increment_amount); break;
+		default:
+			value = song.incrementPatch(selected_entry, increment_amount);
+			if (value == 0) {
+				display.setDisplayAlpha("END"); //the song stops before this entry
+				showSongEntries();
+				return;
+			}
+	}
+	display.setDisplayNum(value);
+	if (song_field == SONG_PATCH) display.setDecimal(memory.patchExists(value));
+	showSongEntries();
+}
+
+void Ui::showSongEntries(){
+	//entries of the song page light up, the playing one is shown inverted
+	Song &song = sequencerVar2->getSong();
+	bool song_matrix[16];
+	byte length = song.getLength();
+	for (byte i = 0; i < 16; i++) {
+		byte entry = i + song_page*16;
+		song_matrix[i] = (entry < length) != (song.isPlaying() && entry == song.getPosition());
+	}
+	ledMatrix.setMatrix(song_matrix);
+	if (selected_entry / 16 == song_page) ledMatrix.selectStep(selected_entry % 16);
 }
 
 bool Ui::cancelSaveOrLoad(){
 	encoder_bumped = false;
 
-	if (ui_mode == LOAD_MODE || ui_mode == SAVE_MODE || ui_mode == EDIT_PARAM_MODE || ui_mode == CALIBRATE_MODE) {
+	if (ui_mode == LOAD_MODE || ui_mode == SAVE_MODE || ui_mode == EDIT_PARAM_MODE || ui_mode == CALIBRATE_MODE || ui_mode == EUCLID_MODE || ui_mode == TRANSFORM_MODE || ui_mode == SONG_MODE || ui_mode == ARP_MODE || ui_mode == MOD_MODE) {
 		if (ui_mode == CALIBRATE_MODE) {
 			digitalWrite(GATE_PIN, LOW);
+		} else if (ui_mode == MOD_MODE) {
+			sequencerVar2->writeModRoutes(); //kept in ram while the encoder edits them
 		}
 		initializeSequenceMode();
 		display.blinkDisplay(true, 100, 1);
 		return true;
 	}
-	erase_counter = 0;
-	display.blinkDisplay(false, 1, 1);
+	if (!queued_patch) display.blinkDisplay(false, 1, 1); //a queued patch keeps blinking until it plays
 	return false;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "calibrate.h"
 #include "dac.h"
 #include "sequencer.h"
+#include "gestures.h"
 
 class Ui{
     public:
@@ -25,18 +26,48 @@ class Ui{
 
         void invertEncoder(); 
         void displaySequenceParam();
+        void refreshMatrix();
         
-        void onButtonToggle(int button, bool button_state);
+        void onButtonToggle(const gesture &g);
+        void onLongPress(const gesture &g);
+        bool shiftHeld();
         void onEncoderIncrement(int increment_amount);
         void selectStep(int step);
-        void selectBar(byte bar);
+        void selectBar(byte bar, const gesture &g);
         void glideButton();
         void initializeSequenceMode();
         void initializeCalibrationMode();
         void updateCalibration(int step);
         bool cancelSaveOrLoad();
-        void shiftFunction(int button);
+        void shiftFunction(const gesture &g);
         void clearSequence();
+        void reseedRandom();
+        void holdFill(bool state);
+        void undo(bool redo);
+        void selectTrack();
+        void selectLaneLength();
+        void selectTrigParam();
+        void selectEuclid();
+        void updateEuclid(int increment_amount);
+        void selectTransformMode();
+        void selectTransform(int button);
+        void selectArpMode();
+        void updateArp(int increment_amount);
+        byte lockParam(byte param);
+        void updateLock(int increment_amount);
         void loadNextSequence();
+        void queuePatch(byte patch);
+        void cancelQueuedPatch();
+        void loadQueuedPatch();
+        void playSongEntry(byte entry);
+        void selectSongMode();
+        void selectSongPage(byte page);
+        void selectSongEntry(byte entry);
+        void updateSongEntry(int increment_amount);
+        void showSongEntries();
+        void selectModMode();
+        void selectModRoute(byte route);
+        void updateModRoute(int increment_amount);
+        void showModRoutes();
 
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+/**
+ * @file analogFilter.h
+ * @brief Smoothing of the oversampled pot and CV readings, and the hysteresis
+ * on the values the knobs set.
+ *
+ * The ADC interrupt sums ADC_OVERSAMPLE conversions per input, AnalogFilter
+ * smooths the sums with an integer IIR, and holdLevel keeps a knob resting on
+ * the boundary between two values from flickering between them. None of it
+ * touches the ADC, so the native tests run the same path.
+ */
+
+#include <stdint.h>
+
+// Rounds of the channels summed into one sample, ~400 Hz per input.
+#define ADC_OVERSAMPLE 4
+// IIR weight of a new sample, 1 / 2^ADC_IIR_SHIFT.
+#define ADC_IIR_SHIFT  2
+// Counts (of 1024) a knob must move past the boundary of the value it sets.
+#define INPUT_HYSTERESIS 3
+
+class AnalogFilter {
+public:
+    /**
+     * @brief Smooth one sum of ADC_OVERSAMPLE conversions. The first sum is
+     * taken as it is, so the filter doesn't ramp up from zero at power-up.
+     * @return The filtered reading, 0-1023.
+     */
+    int update(uint16_t sum) {
+        int sample = sum << 2;
+        if (filtered < 0) {
+            filtered = sample;
+        } else {
+            filtered += (sample - filtered) >> ADC_IIR_SHIFT;
+        }
+        return filtered >> 4; // Back to 0-1023.
+    }
+
+private:
+    int filtered = -1; // 12-bit sums with 2 fractional bits, -1 until the first sample
+};
+
+/**
+ * @brief The level a knob sets, kept at the old one until the reading is
+ * INPUT_HYSTERESIS counts past the boundary between them.
+ * @param held Level the knob set last.
+ * @param level quantize(analogValue).
+ * @param quantize Maps a reading (0-1023) to a level.
+ */
+template <typename Quantize>
+int holdLevel(int held, int level, int analogValue, Quantize quantize) {
+    if (level == held) return held;
+    bool up = level > held;
+    int back = quantize(analogValue + (up ? -INPUT_HYSTERESIS : INPUT_HYSTERESIS));
+    if (up ? back <= held : back >= held) return held;
+    return level;
+}
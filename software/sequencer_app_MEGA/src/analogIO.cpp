@@ -7,26 +7,91 @@
  * - Polls analog inputs both during normal operation and in calibration mode.
  * - Processes analog input changes for pitch, octave, duration, CV and mode parameters.
  * - Updates the display based on the current parameter values.
+ *
+ * The pots and CV inputs are sampled by the ADC in free-running mode. Its conversion
+ * complete interrupt walks the six channels in turn, so every input is sampled at a
+ * fixed ~1.6 kHz whatever the loop is doing, and readInput never waits for a conversion.
+ * Four rounds are summed into one 12-bit sample, which readSample smooths further
+ * with an integer IIR. The CV inputs are handed to the sequencer's modulation matrix. A knob only counts as moved once the value it sets changes,
+ * with hysteresis around the boundaries of that value.
+ *
+ * Knobs don't track the step they edit, so after another step, track or pattern
+ * is selected a knob may sit far from the value it would overwrite. The pickup
+ * mode decides what the knob's next move does: jump to the knob's value, wait
+ * until the knob catches the stored value, or scale towards it.
  */
 
  #include <Arduino.h>
  #include <SPI.h>
  #include <stdint.h>
  #include <string.h>
+ #include <util/atomic.h>
  
  #include "pinout.h"
  #include "analogIO.h"
+ #include "analogFilter.h"
  #include "display.h"
  #include "sequencer.h"
  
- // Array of analog pins used by the system.
- const int analog_pins[4] = { 
+ // Array of analog pins used by the system, the pots first.
+ const int analog_pins[] = { 
 	 ANALOG_PIN_1,
 	 ANALOG_PIN_2,
 	 ANALOG_PIN_3,
-	 ANALOG_PIN_4
+	 ANALOG_PIN_4,
+	 CV_IN_1_PIN,
+	 CV_IN_2_PIN
  };
  
+ // Channels of the ADC scan, and the first of the CV inputs among them.
+ #define ADC_CHANNELS   6
+ #define CV_INPUT       4
+ #define ADC_ALL_FRESH  ((1 << ADC_CHANNELS) - 1)
+ 
+ // ADMUX reference bits for every conversion, AVcc like analogRead's DEFAULT.
+ #define ADC_SCAN_REFERENCE (1 << REFS0)
+ 
+ // Channel of the first conversion after the scan starts, which is thrown away.
+ #define ADC_DISCARD    0xFF
+ 
+ // Samples of the ADC scan. The interrupt fills one bank while readInput takes
+ // from the other, and the banks swap once ADC_OVERSAMPLE rounds are summed.
+ volatile uint16_t adc_samples[2][ADC_CHANNELS];
+ volatile uint8_t adc_bank = 0;     	// Bank being filled by the interrupt.
+ volatile uint8_t adc_fresh = 0;    	// Bit per channel with a sample in the finished bank that hasn't been read.
+ uint16_t adc_sums[ADC_CHANNELS];   	// Conversions of the current rounds (interrupt only).
+ uint8_t adc_round = 0;             	// Rounds summed so far (interrupt only).
+ uint8_t adc_converting = ADC_DISCARD; // Channel of the running conversion (interrupt only).
+ uint8_t adc_requested = 0;         	// Channel in ADMUX, converted after the running one (interrupt only).
+ AnalogFilter adc_filters[ADC_CHANNELS]; // IIR state per channel.
+ 
+ /**
+  * @brief ADC conversion complete interrupt.
+  *
+  * In free-running mode the next conversion starts as soon as one completes, with
+  * the multiplexer as it was at that moment. A channel set here is therefore only
+  * converted after the one already running.
+  */
+ ISR(ADC_vect) {
+	 uint8_t channel = adc_converting;
+	 if (channel != ADC_DISCARD) { // The scan starts on the first channel twice.
+		 adc_sums[channel] += ADC;
+	 }
+	 adc_converting = adc_requested;
+	 adc_requested = adc_requested + 1 < ADC_CHANNELS ? adc_requested + 1 : 0;
+	 ADMUX = ADC_SCAN_REFERENCE | (analog_pins[adc_requested] - A0);
+	 
+	 if (channel == ADC_CHANNELS - 1 && ++adc_round == ADC_OVERSAMPLE) { // Hand the bank over.
+		 for (uint8_t i = 0; i < ADC_CHANNELS; i++) {
+			 adc_samples[adc_bank][i] = adc_sums[i];
+			 adc_sums[i] = 0;
+		 }
+		 adc_round = 0;
+		 adc_bank ^= 1;
+		 adc_fresh = ADC_ALL_FRESH;
+	 }
+ }
+ 
  // Parameter indices for different analog functions.
  #define PITCH_PARAM    0
  #define OCTAVE_PARAM   1
@@ -38,26 +103,36 @@
  #define DISPLAY_MODE_NUMERIC   0
  #define DISPLAY_MODE_NOTE_NAME 127
  
- // Threshold values for analog value change detection.
- #define SHIFT_CHANGE_THRESHOLD   20
- #define DEFAULT_CHANGE_THRESHOLD 12
- #define LOW_CHANGE_THRESHOLD     5
- 
  // Mapping for analog parameters.
  const int analog_params[4] = { PITCH_PARAM, OCTAVE_PARAM, DURATION_PARAM, CV_PARAM };
  
+ // Conversions from analog values (0-1023) to the values the knobs set.
+ static int pitchValue(int analogValue) { return analogValue / 42.1 - 12.1; }          // -12 to +12
+ static int octaveValue(int analogValue) { return analogValue / 120 - 4; }             // -4 to +4
+ static int durationValue(long analogValue) { return analogValue * analogValue / 2615; } // Exponential curve, 0 to 400
+ static int cvModeValue(int analogValue) { return constrain(analogValue >> 8, 0, 3); }  // Quarters of the knob
+ static int auditionValue(int analogValue) { return analogValue > 900; }
+ static int calibrationValue(int analogValue) { return (analogValue - 512) / 10; }
+ 
  // Global flags and variables for analog IO.
  bool editing = false;         			// Flag to allow writing of new analog values.
  bool audition = false;        			// Flag to enable audition (play note on change).
- int lastAnalogValues[4];    			// Store previous analog readings for change detection.
- int analogValues[4];        			// Latest analog readings.
+ int input_levels[4];        			// Values the knobs last set, for change detection.
+ uint8_t input_mappings[4];  			// What each knob set then, see inputMapping().
+ int analogValues[ADC_CHANNELS]; 		// Latest filtered analog readings.
  int analogMultiplexor = 0;  			// Used to cycle through analog inputs.
  int display_param = PITCH_PARAM;  		// Currently selected parameter for display.
  int display_num = 0;        			// Numeric value to be displayed.
  int display_mode = 0;       			// 0: note numbers; 127: note names (e.g. "C1", "B3").
  char display_alpha[4];      			// Alphanumeric display buffer (3 characters + terminator if needed).
  bool param_changed = false; 			// Flag indicating if the parameter has changed.
- int change_threshold = DEFAULT_CHANGE_THRESHOLD; // Dynamic threshold for change detection.
+ bool forced_read = false;    			// Process the input even if it hasn't changed.
+ bool calibrating = false;    			// The CV knob sets the calibration value.
+ uint8_t pickup_modes[4];     			// PICKUP_ mode per parameter.
+ bool pickup_caught[4];       			// Knob has reached the stored value and edits it directly.
+ int pickup_values[4];        			// Stored value as the knob last left it, to notice another step under the knob.
+ int pickup_anchors[4];       			// Knob value where PICKUP_SCALE starts from the stored value.
+ int pickup_anchor_values[4]; 			// Stored value at that point.
  bool recording = false;       			// Flag to indicate if recording is active.
  bool recorded_input_active = false; // Flag to indicate recent input activity.
  char modename[5];            			// Buffer to hold mode names from PROGMEM.
@@ -75,9 +150,20 @@
 	 pinMode(ANALOG_PIN_2, INPUT);
 	 pinMode(ANALOG_PIN_3, INPUT);
 	 pinMode(ANALOG_PIN_4, INPUT);
+	 pinMode(CV_IN_1_PIN, INPUT);
+	 pinMode(CV_IN_2_PIN, INPUT);
 	 
 	 sequencerVar = &sequencer;
 	 
+	 // Free-running scan, prescaler 128: 125 kHz ADC clock, 13 clocks per conversion.
+	 for (uint8_t i = 0; i < ADC_CHANNELS; i++) {
+		 DIDR0 |= 1 << (analog_pins[i] - A0); // Digital input buffers off, less noise. A4/A5 stay digital for the encoder.
+	 }
+	 ADCSRB = 0;     // Free-running trigger, MUX5 clear.
+	 ADMUX = ADC_SCAN_REFERENCE | (analog_pins[0] - A0);
+	 ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+	 while (adc_fresh != ADC_ALL_FRESH) {} // First full sample, under 7 ms.
+	 
 	 // Poll several times to initialize knob positions and avoid accidental edits.
 	 poll(false);
 	 poll(false);
@@ -91,37 +177,43 @@
   * @brief Poll the analog inputs during normal operation.
   *
   * Cycles through the available analog inputs and processes the value change
-  * if the change exceeds a threshold.
+  * if the value the input sets has changed.
   *
   * @param shift_state Current state of the shift button.
   */
  void AnalogIo::poll(bool shift_state) {
 	 analogMultiplexor = (analogMultiplexor + 1) % 4;
-	 
-	 // Increase sensitivity for the selected parameter.
-	 if (display_param == analog_params[analogMultiplexor]) {
-		 change_threshold = LOW_CHANGE_THRESHOLD;
-	 } else {
-		 change_threshold = DEFAULT_CHANGE_THRESHOLD;
-	 }
-	 
+	 calibrating = false;
 	 readInput(analogMultiplexor, shift_state, editing);
  }
  
+ /**
+  * @brief Hand new samples of the CV inputs to the sequencer.
+  *
+  * The sequencer reads them once per step, so they skip the knob hysteresis.
+  */
+ void AnalogIo::readModInputs() {
+	 for (int i = 0; i < MOD_INPUTS; i++) {
+		 if (readSample(CV_INPUT + i)) {
+			 sequencerVar->setModInput(i, analogValues[CV_INPUT + i]);
+		 }
+	 }
+ }
+ 
  /**
   * @brief Poll the analog input for calibration.
   *
-  * Uses a lower threshold for detecting changes.
+  * Changes are detected on the calibration value rather than the CV value.
   */
  void AnalogIo::pollCalibration() {
-	 change_threshold = LOW_CHANGE_THRESHOLD;
+	 calibrating = true;
 	 param_changed = readInput(3, false, false);
  }
  
  /**
   * @brief Read and process an analog input.
   *
-  * Reads the analog input on index 'i' and, if the change is above threshold,
+  * Takes the new sample of input 'i' and, if the value it sets has changed,
   * processes it depending on whether writing of values is enabled.
   *
   * @param i Index of the analog input.
@@ -130,54 +222,203 @@
   * @return true if a significant change was detected, false otherwise.
   */
  bool AnalogIo::readInput(int i, bool shift_state, bool write_values) {
-	 // Read the analog value for channel i.
-	 analogValues[i] = analogRead(analog_pins[i]);
 	 param_changed = false;
 	 
-	 // If the change is larger than the threshold, process the value.
-	 if (abs(analogValues[i] - lastAnalogValues[i]) > (shift_state ? SHIFT_CHANGE_THRESHOLD : change_threshold)) {
-		 recorded_input_active = true;
-		 lastAnalogValues[i] = analogValues[i];
-		 
-		 if (!write_values) {
-			 return true;
+	 // Only a new sample can change anything, unless a reading is forced.
+	 if (!readSample(i) && !forced_read) {
+		 return false;
+	 }
+	 
+	 // Compare the values the knob sets, so noise within one pitch step or CV unit never counts.
+	 uint8_t mapping = inputMapping(i, shift_state);
+	 auto knob = [&](int analogValue) { return quantize(i, mapping, analogValue); };
+	 int level = knob(analogValues[i]);
+	 if (!forced_read) {
+		 if (mapping != input_mappings[i]) {
+			 // The knob now sets something else: take its position without acting on it.
+			 input_mappings[i] = mapping;
+			 input_levels[i] = level;
+			 return false;
 		 }
-		 
-		 switch (i) {
-			 case PITCH_PARAM:
-				 // When shift is held, adjust audition mode instead of pitch.
-				 shift_state ? setAudition(analogValues[0]) : setPitch(analogValues[0]);
-				 break;
-			 case OCTAVE_PARAM:
-				 setOctave(analogValues[1]);
-				 break;
-			 case DURATION_PARAM:
-				 setDuration(analogValues[2]);
-				 break;
-			 case CV_PARAM:
-				 // When shift is held, adjust CV mode; otherwise, adjust CV output.
-				 shift_state ? setCVMode(analogValues[3]) : setCV(analogValues[3]);
-				 break;
+		 // The knob must also be INPUT_HYSTERESIS counts past the boundary of the old
+		 // value, so a knob resting on a boundary doesn't flicker between two values.
+		 if (holdLevel(input_levels[i], level, analogValues[i], knob) == input_levels[i]) {
+			 return false;
 		 }
+	 }
+	 
+	 int prev_level = input_levels[i];
+	 input_levels[i] = level;
+	 input_mappings[i] = mapping;
+	 recorded_input_active = true;
+	 
+	 if (!write_values) {
 		 return true;
 	 }
-	 return false;
+	 
+	 // Live recording and one-step record always take the knob as it is.
+	 int value = level;
+	 if (!shift_state && !recording && !forced_read && !pickUp(i, level, prev_level, value)) {
+		 // Not caught yet, show where the knob has to go.
+		 display_param = i;
+		 displaySelectedParam();
+		 return true;
+	 }
+	 
+	 switch (i) {
+		 case PITCH_PARAM:
+			 // When shift is held, adjust audition mode instead of pitch.
+			 shift_state ? setAudition(analogValues[0]) : setPitch(value);
+			 break;
+		 case OCTAVE_PARAM:
+			 setOctave(value);
+			 break;
+		 case DURATION_PARAM:
+			 setDuration(value);
+			 break;
+		 case CV_PARAM:
+			 // When shift is held, adjust CV mode; otherwise, adjust CV output.
+			 shift_state ? setCVMode(analogValues[3]) : setCV(value);
+			 break;
+	 }
+	 if (!shift_state) {
+		 pickup_values[i] = storedValue(i); // Out-of-scale notes may not have been written.
+	 }
+	 return true;
+ }
+ 
+ /**
+  * @brief Decide what a knob move writes to a parameter that may not be caught yet.
+  *
+  * @param i Index of the analog input.
+  * @param level Value the knob has moved to.
+  * @param prev_level Value the knob was at.
+  * @param value Set to the value to write.
+  * @return true if something should be written, false while the knob hasn't caught the stored value.
+  */
+ bool AnalogIo::pickUp(int i, int level, int prev_level, int &value) {
+	 int stored = storedValue(i);
+	 if (stored != pickup_values[i]) { // Another step under the knob.
+		 pickup_values[i] = stored;
+		 pickup_caught[i] = false;
+		 pickup_anchors[i] = prev_level;
+		 pickup_anchor_values[i] = stored;
+	 }
+	 
+	 value = level;
+	 if (pickup_caught[i] || pickup_modes[i] == PICKUP_JUMP) {
+		 pickup_caught[i] = true;
+		 return true;
+	 }
+	 
+	 if (pickup_modes[i] == PICKUP_CATCH) {
+		 // Caught once the knob reaches or passes the stored value.
+		 pickup_caught[i] = (prev_level <= stored && stored <= level) || (level <= stored && stored <= prev_level);
+		 return pickup_caught[i];
+	 }
+	 
+	 // PICKUP_SCALE: the rest of the knob's travel towards an end covers the
+	 // distance from the stored value to that end, so both meet there.
+	 int anchor = pickup_anchors[i];
+	 int anchor_value = pickup_anchor_values[i];
+	 if (level != anchor) {
+		 int end = quantize(i, input_mappings[i], level > anchor ? 1023 : 0);
+		 value = anchor_value + (long)(level - anchor) * (end - anchor_value) / (end - anchor);
+	 } else {
+		 value = anchor_value;
+	 }
+	 pickup_caught[i] = value == level;
+	 return true;
+ }
+ 
+ /**
+  * @brief Get the value stored for a parameter in the selected step.
+  *
+  * @param i Index of the analog input.
+  * @return The pitch, octave, duration or CV the knob would overwrite.
+  */
+ int AnalogIo::storedValue(int i) {
+	 switch (i) {
+		 case PITCH_PARAM:    return sequencerVar->getPitch();
+		 case OCTAVE_PARAM:   return sequencerVar->getOctave();
+		 case DURATION_PARAM: return sequencerVar->getDuration();
+		 case CV_PARAM:       return sequencerVar->getCv();
+	 }
+	 return 0;
+ }
+ 
+ /**
+  * @brief Take the latest sample of a channel from the finished bank.
+  *
+  * @param i Index of the analog input.
+  * @return true if a sample arrived since the last call, now in analogValues[i].
+  */
+ bool AnalogIo::readSample(int i) {
+	 uint8_t mask = 1 << i;
+	 uint16_t sum;
+	 ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { // The interrupt may swap banks in between.
+		 if (!(adc_fresh & mask)) {
+			 return false;
+		 }
+		 adc_fresh &= ~mask;
+		 sum = adc_samples[adc_bank ^ 1][i];
+	 }
+	 
+	 analogValues[i] = adc_filters[i].update(sum);
+	 return true;
+ }
+ 
+ /**
+  * @brief Identify what an input sets in the current state.
+  *
+  * @param i Index of the analog input.
+  * @param shift_state Current state of the shift button.
+  * @return A different number for each way quantize() maps the input.
+  */
+ uint8_t AnalogIo::inputMapping(int i, bool shift_state) {
+	 if (i == CV_PARAM) {
+		 if (calibrating) return 1;
+		 return shift_state ? 2 : 4 + sequencerVar->getCvMode(); // The CV range depends on the mode.
+	 }
+	 return i == PITCH_PARAM && shift_state;
+ }
+ 
+ /**
+  * @brief Convert an analog value to the value the input sets.
+  *
+  * Every mapping rises with the analog value, which the hysteresis relies on.
+  *
+  * @param i Index of the analog input.
+  * @param mapping The input's mapping from inputMapping().
+  * @param analogValue Filtered analog value.
+  * @return The pitch, octave, duration, CV, mode or calibration value.
+  */
+ int AnalogIo::quantize(int i, uint8_t mapping, int analogValue) {
+	 switch (i) {
+		 case PITCH_PARAM:
+			 return mapping ? auditionValue(analogValue) : pitchValue(analogValue);
+		 case OCTAVE_PARAM:
+			 return octaveValue(analogValue);
+		 case DURATION_PARAM:
+			 return durationValue(analogValue);
+		 case CV_PARAM:
+			 if (mapping == 1) return calibrationValue(analogValue);
+			 if (mapping == 2) return cvModeValue(analogValue);
+			 return sequencerVar->getCv2DisplayValue(analogValue);
+	 }
+	 return 0;
  }
  
  /**
   * @brief Process the pitch parameter from analog input.
   *
-  * Converts the analog value to a pitch, updates the display, and triggers
-  * auditioning if enabled.
+  * Writes the pitch, updates the display, and triggers auditioning if enabled.
   *
-  * @param analogValue Raw analog input value.
+  * @param newVal Pitch from the knob (-12 to +12).
   */
- void AnalogIo::setPitch(int analogValue) {
+ void AnalogIo::setPitch(int newVal) {
 	 display_param = PITCH_PARAM;
 	 
-	 // Convert analog value (0-1023) to a pitch range (-12 to +12)
-	 int newVal = analogValue / 42.1 - 12.1;
-	 
 	 if (recording || sequencerVar->setPitch(newVal)) {
 		 setDisplayNum(newVal);
 		 displayPitchName(newVal, sequencerVar->getOctave());
@@ -190,17 +431,13 @@
  /**
   * @brief Process the octave parameter from analog input.
   *
-  * Converts the analog value to an octave, updates the display,
-  * and triggers auditioning if enabled.
+  * Writes the octave, updates the display, and triggers auditioning if enabled.
   *
-  * @param analogValue Raw analog input value.
+  * @param newVal Octave from the knob (-4 to +4).
   */
- void AnalogIo::setOctave(int analogValue) {
+ void AnalogIo::setOctave(int newVal) {
 	 display_param = OCTAVE_PARAM;
 	 
-	 // Convert analog value to octave range (-4 to +4)
-	 int newVal = analogValue / 120 - 4;
-	 
 	 if (recording || sequencerVar->setOctave(newVal)) {
 		 setDisplayNum(newVal);
 		 displayPitchName(sequencerVar->getPitch(), newVal);
@@ -213,16 +450,13 @@
  /**
   * @brief Process the duration parameter from analog input.
   *
-  * Applies an exponential curve to the analog value and updates the display.
+  * Writes the duration and updates the display.
   *
-  * @param analogValue Raw analog input value.
+  * @param newVal Duration from the knob, on an exponential curve (0 to 400).
   */
- void AnalogIo::setDuration(long analogValue) {
+ void AnalogIo::setDuration(int newVal) {
 	 display_param = DURATION_PARAM;
 	 
-	 // Convert analog value to a duration value with an exponential curve.
-	 int newVal = analogValue * analogValue / 2615;
-	 
 	 if (recording || sequencerVar->setDuration(newVal)) {
 		 setDisplayNum(newVal);
 	 }
@@ -232,14 +466,18 @@
   * @brief Process the CV parameter from analog input.
   *
   * Updates the CV output and the display based on the analog input.
+  * While recording, the value also feeds the sequencer's motion lane,
+  * which samples it several times per step.
   *
-  * @param analogValue Raw analog input value.
+  * @param newVal CV from the knob, in the range of the CV mode.
   */
- void AnalogIo::setCV(int analogValue) {
+ void AnalogIo::setCV(int newVal) {
 	 display_param = CV_PARAM;
 	 
-	 if (recording || sequencerVar->setCv2(analogValue)) {
-		 int newVal = sequencerVar->getCv2DisplayValue(analogValue);
+	 if (recording) {
+		 sequencerVar->setMotionInput(newVal);
+	 }
+	 if (recording || sequencerVar->setCv2(newVal)) {
 		 setDisplayNum(newVal);
 		 displayCvName(newVal);
 	 }
@@ -331,8 +569,9 @@
 	 
 	 // Temporarily disable recording to allow one-step record.
 	 recording = false;
-	 change_threshold = -1; // Force recording regardless of change magnitude.
+	 forced_read = true; // Force recording regardless of change magnitude.
 	 readInput(display_param, false, true);
+	 forced_read = false;
 	 recording = true;
  }
  
@@ -355,6 +594,32 @@
 	 display_mode = mode;
  }
  
+ /**
+  * @brief Set the pickup mode of every knob.
+  *
+  * Knobs are released, so they pick up the stored values again.
+  *
+  * @param mode PICKUP_JUMP, PICKUP_CATCH or PICKUP_SCALE.
+  */
+ void AnalogIo::setPickupMode(int mode) {
+	 for (int i = 0; i < 4; i++) {
+		 pickup_modes[i] = mode;
+		 pickup_caught[i] = false;
+		 pickup_values[i] = storedValue(i);
+		 pickup_anchors[i] = input_levels[i];
+		 pickup_anchor_values[i] = pickup_values[i];
+	 }
+ }
+ 
+ /**
+  * @brief Get the pickup mode of the knobs.
+  *
+  * @return PICKUP_JUMP, PICKUP_CATCH or PICKUP_SCALE.
+  */
+ int AnalogIo::getPickupMode() {
+	 return pickup_modes[PITCH_PARAM];
+ }
+ 
  /**
   * @brief Get the current numeric display value.
   *
@@ -405,17 +670,7 @@
   */
  void AnalogIo::setCVMode(int analogValue) {
 	 display_param = MODE_PARAM;
-	 uint8_t cv_mode = 0;
-	 
-	 if (analogValue < 256) {
-		 cv_mode = 0;
-	 } else if (analogValue < 512) {
-		 cv_mode = 1;
-	 } else if (analogValue < 768) {
-		 cv_mode = 2;
-	 } else {
-		 cv_mode = 3;
-	 }
+	 uint8_t cv_mode = cvModeValue(analogValue);
 	 
 	 // Copy the corresponding mode name from PROGMEM.
 	 strcpy_P(modename, (char *)pgm_read_word(&(cvmode_names[cv_mode])));
@@ -434,7 +689,7 @@
  void AnalogIo::setAudition(int analogValue) {
 	 display_param = MODE_PARAM;
 	 
-	 if (analogValue > 900) {
+	 if (auditionValue(analogValue)) {
 		 audition = true;
 		 strcpy_P(modename, (char *)pgm_read_word(&(audition_names[1])));
 	 } else {
@@ -456,7 +711,7 @@
   * @return int Calibration value.
   */
  int AnalogIo::getCalibrationValue() {
-	 int calibration_value = (analogValues[3] - 512) / 10;
+	 int calibration_value = calibrationValue(analogValues[3]);
 	 setDisplayNum(calibration_value);
 	 return calibration_value;
  }
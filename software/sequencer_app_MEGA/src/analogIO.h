@@ -33,6 +33,12 @@ const char cvmode_3[] PROGMEM = "NOT"; // Note mode
 // Array of pointers to CV mode strings stored in PROGMEM
 const char *const cvmode_names[] PROGMEM = { cvmode_0, cvmode_1, cvmode_2, cvmode_3 };
 
+// What a knob does to a stored value it doesn't match yet.
+const uint8_t PICKUP_JUMP = 0;  // Overwrite it with the knob's value straight away.
+const uint8_t PICKUP_CATCH = 1; // Leave it until the knob reaches it.
+const uint8_t PICKUP_SCALE = 2; // Move it in proportion, meeting the knob at the end of its travel.
+const uint8_t PICKUP_MODES = 3;
+
 class AnalogIo {
 public:
     /**
@@ -54,6 +60,14 @@ public:
      */
     void pollCalibration();
 
+    /**
+     * @brief Hand new samples of the CV inputs to the sequencer's modulation matrix.
+     *
+     * Called every pass, whatever the UI mode, so modulation keeps running in
+     * the modes that don't read the pots.
+     */
+    void readModInputs();
+
     /**
      * @brief Display the currently selected parameter.
      */
@@ -115,6 +129,20 @@ public:
      */
     void setDisplayMode(int mode);
 
+    /**
+     * @brief Set the pickup mode of every knob.
+     * 
+     * @param mode PICKUP_JUMP, PICKUP_CATCH or PICKUP_SCALE.
+     */
+    void setPickupMode(int mode);
+
+    /**
+     * @brief Get the pickup mode of the knobs.
+     * 
+     * @return int PICKUP_JUMP, PICKUP_CATCH or PICKUP_SCALE.
+     */
+    int getPickupMode();
+
 private:
     /**
      * @brief Read an analog input.
@@ -128,25 +156,73 @@ private:
     bool readInput(int i, bool shift_state, bool write_values);
 
     /**
-     * @brief Set pitch based on the analog value.
+     * @brief Take a new sample of an analog input from the ADC scan.
      * 
-     * @param analogValue The analog input value.
+     * @param i The input index.
+     * @return true if a sample arrived since the last call.
+     * @return false if the input hasn't been converted again yet.
      */
-    void setPitch(int analogValue);
+    bool readSample(int i);
 
     /**
-     * @brief Set the octave based on the analog value.
+     * @brief Identify what an input sets in the current state.
      * 
-     * @param analogValue The analog input value.
+     * @param i The input index.
+     * @param shift_state Current state of the shift button.
+     * @return A different number for each way quantize() maps the input.
      */
-    void setOctave(int analogValue);
+    uint8_t inputMapping(int i, bool shift_state);
 
     /**
-     * @brief Set the note duration based on the analog value.
+     * @brief Convert an analog value to the value the input sets.
      * 
-     * @param analogValue The analog input value.
+     * @param i The input index.
+     * @param mapping The input's mapping from inputMapping().
+     * @param analogValue Filtered analog value.
+     * @return The pitch, octave, duration, CV, mode or calibration value.
+     */
+    int quantize(int i, uint8_t mapping, int analogValue);
+
+    /**
+     * @brief Decide what a knob move writes to a parameter that may not be caught yet.
+     * 
+     * @param i The input index.
+     * @param level Value the knob has moved to.
+     * @param prev_level Value the knob was at.
+     * @param value Set to the value to write.
+     * @return true if something should be written.
+     * @return false while the knob hasn't caught the stored value.
      */
-    void setDuration(long analogValue);
+    bool pickUp(int i, int level, int prev_level, int &value);
+
+    /**
+     * @brief Get the value stored for a parameter in the selected step.
+     * 
+     * @param i The input index.
+     * @return int The pitch, octave, duration or CV the knob would overwrite.
+     */
+    int storedValue(int i);
+
+    /**
+     * @brief Set pitch from the knob.
+     * 
+     * @param newVal The pitch (-12 to +12).
+     */
+    void setPitch(int newVal);
+
+    /**
+     * @brief Set the octave from the knob.
+     * 
+     * @param newVal The octave (-4 to +4).
+     */
+    void setOctave(int newVal);
+
+    /**
+     * @brief Set the note duration from the knob.
+     * 
+     * @param newVal The duration (0 to 400).
+     */
+    void setDuration(int newVal);
 
     /**
      * @brief Update the numeric value to be displayed.
@@ -163,11 +239,11 @@ private:
     void setDisplayAlpha(char displayAlpha[4]);
 
     /**
-     * @brief Set the CV (control voltage) output based on analog value.
+     * @brief Set the CV (control voltage) output from the knob.
      * 
-     * @param analogValue The analog input value.
+     * @param newVal The CV, in the range of the CV mode.
      */
-    void setCV(int analogValue);
+    void setCV(int newVal);
 
     /**
      * @brief Set the CV mode based on analog input.
@@ -4,6 +4,16 @@
  *
  * This file implements scanning of a 4x8 button matrix, debouncing,
  * event queue handling, and control of a glide LED via NeoPixel.
+ *
+ * The matrix is scanned by a 1 kHz Timer2 interrupt, all four rows per tick,
+ * with the row and column registers looked up once at init. Button latency no
+ * longer depends on how long the loop takes, and the loop only pops events.
+ * Each event is queued with the micros() time it was seen.
+ *
+ * All 32 keys are debounced in parallel by vertical counters (debounce.h): bit n of three
+ * words forms a 3-bit counter for key n, counting scans in which the key differs
+ * from its debounced state. A key changes state after 7 such scans in a row, so
+ * chords and shift + step combinations debounce as well as single keys.
  */
 
  #include "pinout.h"
@@ -12,7 +22,7 @@
  #include "sequencer.h"
  #include "queue_ino.h"
  #include "buttonMap.h"
- #include <elapsedMillis.h>
+ #include "debounce.h"
  #include <Adafruit_NeoPixel.h>
  
  //-----------------------------------------------------------------------------
@@ -23,24 +33,90 @@
  // GLIDE_NEOPIXEL_PIN is defined in pinout.h.
  Adafruit_NeoPixel glideNeo = Adafruit_NeoPixel(1, GLIDE_NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800);
  
- // Define an event queue with capacity 8 for uint16_t events.
- QUEUE(events, uint16_t, 8);
- volatile struct queue_events queue;
+ // Button events, pushed by the scan interrupt and popped by the loop.
+ EventQueue<uint16_t, 16> queue;
+ uint32_t event_time = 0; // Time of the last event popped.
  
- // Flag to indicate if button editing (initialization) is complete.
- bool editing_buttons = false;
+ // Debounced state of the 32 buttons (4 rows x 8 columns), bit per physical index.
+ // Scans at 1 kHz, so a key has to hold a new state for 7 ms.
+ VerticalDebounce keys;
  
- // Debounce settings.
- const byte BUTTON_DEBOUNCE_TIME = 10; // Debounce duration in milliseconds.
- elapsedMillis debounce_timer;           // Timer to track debounce period.
- volatile uint16_t bouncing_button = 0x00; // Last button (logical ID) that triggered an event.
+ // Time a row is driven before its columns are read, so the pull-ups can recover
+ // from a key held on the row before.
+ const byte BUTTON_SETTLE_US = 5;
  
- // Button matrix state for 32 buttons (4 rows x 8 columns).
- bool button_matrix[32] = { false };
+ // Port registers and bit masks of the row and column pins, looked up once in init.
+ volatile uint8_t *row_ports[4];
+ uint8_t row_masks[4];
+ volatile uint8_t *col_pins[8];
+ uint8_t col_masks[8];
  
  // External mapping array to map physical button indices to logical IDs.
  extern const int button_map[32];
  
+ //-----------------------------------------------------------------------------
+ // Matrix Scan
+ //-----------------------------------------------------------------------------
+ 
+ /**
+  * @brief Read all four rows of the button matrix.
+  *
+  * Each row is driven LOW in turn and its eight columns read from their port registers.
+  *
+  * @return uint32_t Bit per physical index, set while the button is pressed.
+  */
+ static uint32_t readMatrix() {
+     uint32_t raw = 0;
+     for (uint8_t row = 0; row < 4; row++) {
+         // Activate the current row by driving it LOW.
+         *row_ports[row] &= ~row_masks[row];
+         delayMicroseconds(BUTTON_SETTLE_US);
+         
+         // With INPUT_PULLUP, a pressed button reads LOW.
+         uint8_t pressed = 0;
+         for (uint8_t col = 0; col < 8; col++) {
+             if (!(*col_pins[col] & col_masks[col])) {
+                 pressed |= 1 << col;
+             }
+         }
+         raw = (raw >> 8) | ((uint32_t)pressed << 24); // Rows fill the word from the bottom byte up.
+         
+         // Deactivate the current row by setting it back to HIGH.
+         *row_ports[row] |= row_masks[row];
+     }
+     return raw;
+ }
+ 
+ /**
+  * @brief Scan the button matrix and queue an event for every debounced change.
+  */
+ static void scanMatrix() {
+     uint32_t toggled = keys.update(readMatrix());
+     if (!toggled) {
+         return;
+     }
+     unsigned long now = micros();
+     for (uint8_t buttonIndex = 0; buttonIndex < 32; buttonIndex++) {  // Physical index in the 4x8 matrix.
+         if (toggled & 1) {
+             // Pack the event into a 16-bit value:
+             // Lower 8 bits: mapped button ID; upper 8 bits: state (1 for pressed, 0 for released).
+             bool pressed = keys.getState() >> buttonIndex & 1;
+             queue.push(button_map[buttonIndex] | (pressed << 8), now);
+         }
+         toggled >>= 1;
+     }
+ }
+ 
+ /**
+  * @brief Timer2 compare match interrupt, 1 kHz.
+  *
+  * A scan takes ~25 us, so other interrupts are let in. The ADC scan has to set
+  * its next channel within a conversion.
+  */
+ ISR(TIMER2_COMPA_vect, ISR_NOBLOCK) {
+     scanMatrix();
+ }
+ 
  //-----------------------------------------------------------------------------
  // Buttons Class Member Functions
  //-----------------------------------------------------------------------------
@@ -49,19 +125,23 @@
   * @brief Initialize the button matrix hardware and internal state.
   *
   * This function sets up row pins as outputs (initially HIGH) and column pins as
-  * INPUT_PULLUP. It also initializes the glide LED (NeoPixel) and polls the button
-  * matrix several times to stabilize initial states.
+  * INPUT_PULLUP. It also initializes the glide LED (NeoPixel), reads the initial
+  * button states, and starts the scan interrupt.
   */
  void Buttons::init() {
      // Initialize row pins as OUTPUT and set them HIGH (inactive).
      for (int i = 0; i < 4; i++) {
          pinMode(buttonRows[i], OUTPUT);
          digitalWrite(buttonRows[i], HIGH);
+         row_ports[i] = portOutputRegister(digitalPinToPort(buttonRows[i]));
+         row_masks[i] = digitalPinToBitMask(buttonRows[i]);
      }
      
      // Initialize column pins as INPUT_PULLUP.
      for (int i = 0; i < 8; i++) {
          pinMode(buttonCols[i], INPUT_PULLUP);
+         col_pins[i] = portInputRegister(digitalPinToPort(buttonCols[i]));
+         col_masks[i] = digitalPinToBitMask(buttonCols[i]);
      }
      
      // Initialize the NeoPixel for the glide LED.
@@ -69,84 +149,55 @@
      glideNeo.clear();
      glideNeo.show();
      
-     // Poll several times to stabilize the initial button states.
-     poll();
-     poll();
-     poll();
-     poll();
+     // Take the keys held at power-up as they are, without events.
+     keys.reset(readMatrix());
      
-     editing_buttons = true;
+     // Timer2 in CTC mode, 16 MHz / 64 / 250 = 1 kHz.
+     TCCR2A = (1 << WGM21);
+     TCCR2B = (1 << CS22);
+     OCR2A = 249;
+     TIMSK2 = (1 << OCIE2A);
  }
  
  /**
-  * @brief Poll the button matrix.
+  * @brief Retrieve a queued button event.
+  *
+  * Removes and returns an event from the queue.
   *
-  * Scans one row of the button matrix at a time, updating the state of each button.
-  * If a button state change is detected, an event is generated.
+  * @param value Reference to store the event value.
+  * @return int 0 if an event was popped, not 0 if the queue was empty.
   */
- void Buttons::poll() {
-     // Cycle through the 4 rows.
-     row = (row + 1) % 4;
-     
-     // Activate the current row by driving it LOW.
-     digitalWrite(buttonRows[row], LOW);
-     
-     // Scan each column in the current row.
-     for (int col = 0; col < 8; col++) {
-         int buttonIndex = row * 8 + col;  // Calculate physical index in the 4x8 matrix.
-         // With INPUT_PULLUP, a pressed button reads LOW.
-         bool pressed = (digitalRead(buttonCols[col]) == LOW);
-         
-         // Map the physical button index to a logical button ID.
-         int mappedButton = button_map[buttonIndex];
-         
-         // If the button state has changed:
-         if (pressed != button_matrix[buttonIndex]) {
-             // Update the matrix state.
-             button_matrix[buttonIndex] = pressed;
-             // Pack the event into a 16-bit value:
-             // Lower 8 bits: mapped button ID; upper 8 bits: state (1 for pressed, 0 for released).
-             uint16_t event = mappedButton | (pressed << 8);
-             onButtonPush(event);
-         }
-     }
-     
-     // Deactivate the current row by setting it back to HIGH.
-     digitalWrite(buttonRows[row], HIGH);
+ int Buttons::getQueuedEvent(uint16_t &value) {
+     return queue.pop(value, event_time) ? 0 : -1;
  }
  
  /**
-  * @brief Handle a button push event with debounce.
+  * @brief Get the time of the last event returned by getQueuedEvent.
   *
-  * If the same button triggers an event within the debounce period, the event is ignored.
-  * Otherwise, the event is added to the event queue.
-  *
-  * @param event Reference to the 16-bit event value.
+  * @return unsigned long micros() when the scan saw the event.
   */
- void Buttons::onButtonPush(uint16_t &event) {
-     if (editing_buttons) {
-         // Check if the same button is bouncing.
-         if (debounce_timer < BUTTON_DEBOUNCE_TIME && (event & 0x00FF) == bouncing_button) {
-             return;
-         }
-         // Push the event onto the queue.
-         queue_events_push(&queue, &event);
-         // Record which button triggered the event.
-         bouncing_button = event & 0x00FF;
-         debounce_timer = 0;
-     }
+ unsigned long Buttons::getEventTime() {
+     return event_time;
  }
  
  /**
-  * @brief Retrieve a queued button event.
+  * @brief Get how many button events were dropped because the queue was full.
   *
-  * Removes and returns an event from the queue.
+  * Shown on the calibration screen, a nonzero count means the loop fell behind.
   *
-  * @param value Reference to store the event value.
-  * @return int Number of events in the queue after the pop (or an error code).
+  * @return uint16_t Drops since power-up.
   */
- int Buttons::getQueuedEvent(uint16_t &value) {
-     return queue_events_pop(&queue, &value);
+ uint16_t Buttons::getDroppedEvents() {
+     return queue.getDrops();
+ }
+ 
+ /**
+  * @brief Get the most button events ever waiting in the queue at once.
+  *
+  * @return uint8_t High-water mark since power-up, out of the 16 the queue holds.
+  */
+ uint8_t Buttons::getQueueHighWater() {
+     return queue.getHighWater();
  }
  
  /**
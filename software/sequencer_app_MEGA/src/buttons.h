@@ -23,17 +23,10 @@ class Buttons {
     ~Buttons() { }
     
     /**
-     * @brief Initialize the button matrix hardware and internal state.
+     * @brief Initialize the button matrix hardware and start the scan interrupt.
      */
     void init();
 
-    /**
-     * @brief Poll the button matrix and update internal state.
-     *
-     * This method scans the matrix to detect button state changes.
-     */
-    void poll();
-
     /**
      * @brief Retrieve a queued button event.
      *
@@ -42,6 +35,23 @@ class Buttons {
      */
     int getQueuedEvent(uint16_t &value);
 
+    /**
+     * @brief Get the time of the last event returned by getQueuedEvent.
+     *
+     * @return unsigned long micros() when the scan saw the event.
+     */
+    unsigned long getEventTime();
+
+    /**
+     * @brief Get how many button events were dropped because the queue was full.
+     */
+    uint16_t getDroppedEvents();
+
+    /**
+     * @brief Get the most button events ever waiting in the queue at once.
+     */
+    uint8_t getQueueHighWater();
+
     /**
      * @brief Set the state of the glide LED.
      *
@@ -66,18 +76,6 @@ class Buttons {
     void repeatButton(bool state);
     void glideButton(bool state);
 
-    /**
-     * @brief Called when a button is pushed (or released).
-     *
-     * Processes the event and updates the event value.
-     *
-     * @param event Reference to the event value.
-     */
-    void onButtonPush(uint16_t &event);
-
-    // State of the button matrix (16 buttons) for navigation/selection.
-    bool button_matrix[16] = { false };
-
     // Counter used for the save button (for example, to track multiple presses).
     int saveCount = 0;
 
@@ -85,7 +83,6 @@ class Buttons {
     bool function_button_matrix[16] = { false };
 
     // Variables used for scanning the matrix.
-    int row = 0;              // Current row being scanned.
     uint16_t buttons_state;   // Combined state of all buttons (bitfield).
     uint16_t buttons_mask;    // Mask for determining active/pressed buttons.
 };
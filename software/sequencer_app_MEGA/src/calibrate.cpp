@@ -1,7 +1,7 @@
 // #include "Variables.h"
 // #include "AnalogIO.h"
-#include "Calibrate.h"
-#include "Display.h"
+#include "calibrate.h"
+#include "display.h"
 #include <EEPROM.h>
 
 const int calibrationEEPROMAddress = 0;
@@ -9,6 +9,9 @@ const int calibrationEEPROMAddress = 0;
 const int displayModeEEPROMAddress = 20; //set whether to display numbers or note names C0, B1
 const int calibrationValuesEEPROMAddress2 = 24; //9 values
 const int mutateOnResetAddress = 36;
+const int switchQuantizeAddress = 42; //cv2 calibration values take 33-41
+const int pickupModeAddress = 43;
+const int modRoutesAddress = 44; //3 bytes per route, up to 55
 
 
 unsigned int octave_values[9] = { 0,   500,  1000, 1500, 2000, 2500, 3000, 3500, 4000 };
@@ -114,4 +117,28 @@ bool Calibration::readMutateOnReset(){
 
 void Calibration::writeMutateOnReset(bool val){
 	EEPROM.update(mutateOnResetAddress, val);
+}
+
+int Calibration::readSwitchQuantize(){
+	return EEPROM.read(switchQuantizeAddress);
+}
+
+void Calibration::writeSwitchQuantize(int val){
+	EEPROM.update(switchQuantizeAddress, val);
+}
+
+int Calibration::readPickupMode(){
+	return EEPROM.read(pickupModeAddress);
+}
+
+void Calibration::writePickupMode(int val){
+	EEPROM.update(pickupModeAddress, val);
+}
+
+int Calibration::readModRoute(int route, int field){
+	return EEPROM.read(modRoutesAddress + route * 3 + field);
+}
+
+void Calibration::writeModRoute(int route, int field, int val){
+	EEPROM.update(modRoutesAddress + route * 3 + field, val);
 }
\ No newline at end of file
@@ -29,4 +29,16 @@ class Calibration {
         bool readMutateOnReset();
 
         void writeMutateOnReset(bool val);
+
+        int readSwitchQuantize();
+
+        void writeSwitchQuantize(int val);
+
+        int readPickupMode();
+
+        void writePickupMode(int val);
+
+        int readModRoute(int route, int field);
+
+        void writeModRoute(int route, int field, int val);
 };
@@ -1,5 +1,5 @@
-#include "Pinout.h"   // Ensure that this header defines CSDAC_PIN, DAC_DATA_PIN, and DAC_CLOCK_PIN
-#include "Dac.h"
+#include "pinout.h"   // Ensure that this header defines CSDAC_PIN, DAC_DATA_PIN, and DAC_CLOCK_PIN
+#include "dac.h"
 #include <Arduino.h>
 
 // Note: Since 'val' is unsigned, no need to check for negative values.
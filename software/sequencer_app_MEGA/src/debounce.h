@@ -0,0 +1,56 @@
+#pragma once
+/**
+ * @file debounce.h
+ * @brief Debounces 32 keys in parallel with vertical counters.
+ *
+ * Bit n of three words forms a 3-bit counter for key n, counting the scans in
+ * which the key differs from its debounced state. A key changes state after 7
+ * such scans in a row, and a scan that agrees with the debounced state starts
+ * its count again, as does the change itself. The button scan interrupt feeds
+ * it one matrix reading per scan, the native tests feed it readings of their
+ * own.
+ */
+
+#include <stdint.h>
+
+class VerticalDebounce {
+public:
+    /**
+     * @brief Take a reading as the debounced state, without any changes,
+     * e.g. the keys held at power-up.
+     */
+    void reset(uint32_t raw) {
+        key_state = raw;
+        count0 = count1 = count2 = 0;
+    }
+
+    /**
+     * @brief Debounce one reading of every key.
+     *
+     * Counters of keys that match their debounced state are cleared, the others
+     * count up, and a key whose counter reaches 7 takes the new state.
+     *
+     * @param raw Bit per key, set while it reads pressed.
+     * @return Bit per key whose debounced state changed.
+     */
+    uint32_t update(uint32_t raw) {
+        uint32_t delta = raw ^ key_state;
+        count2 = (count2 ^ (count1 & count0)) & delta;
+        count1 = (count1 ^ count0) & delta;
+        count0 = ~count0 & delta;
+        uint32_t toggled = count0 & count1 & count2;
+        key_state ^= toggled;
+        count0 &= ~toggled; //else a change on the very next scan wraps the counter and takes 8
+        count1 &= ~toggled;
+        count2 &= ~toggled;
+        return toggled;
+    }
+
+    uint32_t getState() { return key_state; }
+
+private:
+    uint32_t key_state = 0;
+    uint32_t count0 = 0;
+    uint32_t count1 = 0;
+    uint32_t count2 = 0;
+};
@@ -2,6 +2,7 @@
 #include "pinout.h"
 #include "analogIO.h"
 #include "encoder.h"
+#include "quadrature.h"
 #include "display.h"
 #include "calibrate.h"
 #include "sequencer.h"
@@ -9,6 +10,8 @@
 #include <stdint.h>
 
 #include <EEPROM.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
 
 int increment_amount = 0;
@@ -19,33 +22,57 @@ uint8_t pinB = 0xFF;
 int8_t invert_encoder = 1;
 const int encoder_invert_address = 16;
 
+//the encoder is sampled from an interrupt, so a slow loop() no longer misses quadrature states
+volatile int8_t encoder_steps = 0; //transitions counted since the last poll, 4 per detent. sticks at the int8_t limits
+volatile uint8_t *enc_a_port;
+volatile uint8_t *enc_b_port;
+uint8_t enc_a_mask;
+uint8_t enc_b_mask;
+
+//A4/A5 are on port F, which has no pin change interrupts on the 2560, so the pins are
+//sampled on timer0's compare B instead. timer0 already runs for millis(), at ~1 kHz
+ISR(TIMER0_COMPB_vect) {
+	static uint8_t old_AB = 0;
+	int8_t step = quadratureStep(old_AB, *enc_a_port & enc_a_mask, *enc_b_port & enc_b_mask);
+	if (step) encoder_steps = addSteps(encoder_steps, step);
+}
+
 void Encoder::init(){
 	pinMode(ENC_A_PIN, INPUT_PULLUP); //encoder A
 	pinMode(ENC_B_PIN, INPUT_PULLUP); //encoder B
 	invert_encoder = EEPROM.read(encoder_invert_address) > 0 ? -1 : 1;
+	enc_a_port = portInputRegister(digitalPinToPort(ENC_A_PIN));
+	enc_b_port = portInputRegister(digitalPinToPort(ENC_B_PIN));
+	enc_a_mask = digitalPinToBitMask(ENC_A_PIN);
+	enc_b_mask = digitalPinToBitMask(ENC_B_PIN);
+	OCR0B = 128; //anywhere in the count, only the interrupt is used
+	TIMSK0 |= (1 << OCIE0B);
 }
 
-//magic numbers from https://www.circuitsathome.com/mcu/reading-rotary-encoder-on-arduino/
+/* returns all detents turned since the last poll */
 int Encoder::poll(){
-	///* returns change in encoder state (-1,0,1) */
-	//int8_t read_encoder()
-	//{
+	int8_t steps;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		steps = encoder_steps;
+		encoder_steps = 0;
+	}
 	increment_amount = 0;
-	static int8_t enc_states[] = { 0,-1,1,0,1,0,0,-1,-1,0,0,1,0,1,-1,0 };
-	static uint8_t old_AB = 0;
-	/**/
-	old_AB <<= 2;                   //remember previous state
-	old_AB |= (ENC_PORT & 0x30) >> 4;  //add current state from pins A5 and A4, shifted to LSB
-	encoder_increment(enc_states[(old_AB & 0x0f)]); //extract encrement/decrement value from state table
+	encoder_increment(steps);
+	if (increment_amount != 0) {
+		unsigned long now = millis();
+		acceleration = detentAcceleration(increment_amount, now - last_detent);
+		last_detent = now;
+	}
 	return increment_amount * invert_encoder;
 }
 
+int Encoder::accelerate(int amount){
+	return amount * acceleration;
+}
+
 void Encoder::encoder_increment(int amt) {
 	if (amt == 0) return;
-	encoder_amount += amt;
-	if (abs(encoder_amount) < 4) return; //encoder detent is too coarse for 1-per step granularity
-	increment_amount = encoder_amount > 0 ? 1 : -1;
-	encoder_amount = 0;
+	increment_amount = takeDetents(encoder_amount, amt);
 }
 
 bool Encoder::toggle_inverted(){
@@ -4,10 +4,13 @@ class Encoder{
     public:
         void init();
         int poll();
+        int accelerate(int amount); //scales detents from the last poll by how fast the encoder turned, for wide ranges
         int smartPoll();
         int encoder_amount = 0;
         int increment_amount = 0;
         bool toggle_inverted();
     private:
         void encoder_increment(int amt);
+        unsigned long last_detent = 0;
+        uint8_t acceleration = 1;
 };
\ No newline at end of file
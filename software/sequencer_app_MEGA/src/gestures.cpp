@@ -0,0 +1,58 @@
+#include "gestures.h"
+
+bool Gestures::onKey(uint8_t key, bool pressed, uint32_t time, gesture &g){
+    if (key >= GESTURE_KEYS) return false;
+    uint16_t now = time >> 10;
+
+    g.key = key;
+    g.type = pressed ? GESTURE_PRESS : GESTURE_RELEASE;
+    g.taps = 0;
+    g.chord = GESTURE_NO_KEY;
+
+    if (pressed) {
+        if (key == last_key && !(state[key] & HELD) && (uint16_t)(now - edge_time[key]) < MULTI_TAP_TICKS) {
+            if (taps < 255) taps++;
+        } else {
+            taps = 1;
+        }
+        g.taps = taps;
+        if (isHeld(last_held)) { //the key pressed last, so shift + A + B chords on A
+            g.chord = last_held;
+        } else {
+            for (uint8_t i = 0; i < GESTURE_KEYS; i++) {
+                if (state[i] & HELD) {
+                    g.chord = i;
+                    break;
+                }
+            }
+        }
+        state[key] = HELD;
+        last_key = key;
+        last_held = key;
+    } else {
+        state[key] = 0;
+    }
+    edge_time[key] = now;
+    return true;
+}
+
+bool Gestures::poll(uint32_t now, gesture &g){
+    uint16_t ticks = now >> 10;
+    for (uint8_t i = 0; i < GESTURE_KEYS; i++) {
+        if (state[i] != HELD || (uint16_t)(ticks - edge_time[i]) < LONG_PRESS_TICKS) continue;
+        state[i] |= LONG_DONE;
+        g.key = i;
+        g.type = GESTURE_LONG_PRESS;
+        g.taps = i == last_key ? taps : 1;
+        g.chord = GESTURE_NO_KEY;
+        if (i == last_key) taps = 0; //a tap after a long press is a first tap
+        return true;
+    }
+    return false;
+}
+
+void Gestures::cancelLongPress(){
+    for (uint8_t i = 0; i < GESTURE_KEYS; i++) {
+        if (state[i] & HELD) state[i] |= LONG_DONE;
+    }
+}
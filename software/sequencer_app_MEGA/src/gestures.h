@@ -0,0 +1,70 @@
+#pragma once
+/**
+ * @file gestures.h
+ * @brief Turns timestamped key edges into presses, releases, long presses,
+ * multi-taps and chords.
+ *
+ * Every edge from the button queue comes out as one gesture straight away, so
+ * a press still acts on the press. What the UI used to work out with flags
+ * travels with it instead: how many times in a row the key was tapped, and
+ * which other key was already held. A key held for LONG_PRESS_MS gives one
+ * more gesture, from poll().
+ *
+ * Each key keeps a held bit, a long press bit and the time of its last edge,
+ * 3 bytes. Times are micros() >> 10, ticks of 1.024 ms, kept to 16 bits. That
+ * counter wraps on a 65536 boundary along with micros(), so spans stay right
+ * across the wrap, unlike micros() / 1000.
+ */
+
+#include <stdint.h>
+
+const uint8_t GESTURE_PRESS = 0;
+const uint8_t GESTURE_RELEASE = 1;
+const uint8_t GESTURE_LONG_PRESS = 2;
+
+const uint8_t GESTURE_KEYS = 32;       // key ids from the button map, others are ignored
+const uint8_t GESTURE_NO_KEY = 0xFF;
+const uint16_t LONG_PRESS_MS = 600;
+const uint16_t MULTI_TAP_MS = 400;     // from a release to the next press of the same key
+const uint16_t LONG_PRESS_TICKS = LONG_PRESS_MS * 1000UL >> 10;
+const uint16_t MULTI_TAP_TICKS = MULTI_TAP_MS * 1000UL >> 10;
+
+struct gesture {
+    uint8_t key;
+    uint8_t type;
+    uint8_t taps;   // presses of this key in a row, 2 for a double tap. 0 for a release
+    uint8_t chord;  // key already held when this one was pressed, the latest one, or GESTURE_NO_KEY
+};
+
+class Gestures {
+public:
+    /**
+     * @brief Classify one key edge.
+     * @param time micros() when the scan saw it.
+     * @return False for keys outside the map, which give no gesture.
+     */
+    bool onKey(uint8_t key, bool pressed, uint32_t time, gesture &g);
+
+    /**
+     * @brief Find a key held past LONG_PRESS_MS, once per press.
+     * @return False if there is none.
+     */
+    bool poll(uint32_t now, gesture &g);
+
+    /**
+     * @brief Keys held now give no long press, e.g. once a knob turned while they were down.
+     */
+    void cancelLongPress();
+
+    bool isHeld(uint8_t key) { return key < GESTURE_KEYS && (state[key] & HELD); }
+
+private:
+    static const uint8_t HELD = 1;
+    static const uint8_t LONG_DONE = 2; // long press given or cancelled
+
+    uint8_t state[GESTURE_KEYS] = {0};
+    uint16_t edge_time[GESTURE_KEYS] = {0};
+    uint8_t last_key = GESTURE_NO_KEY;  // last key pressed, taps only count on for the same key
+    uint8_t last_held = GESTURE_NO_KEY; // latest key pressed that is still down
+    uint8_t taps = 0;
+};
@@ -0,0 +1,127 @@
+#include "journal.h"
+
+void Journal::clear(){
+    first = 0;
+    length = 0;
+    applied = 0;
+    group_first = 0;
+    group_pending = false;
+    group_lost = false;
+}
+
+void Journal::begin(){
+    length = applied; //a new edit ends the redo history
+    group_first = length;
+    group_pending = true;
+    group_lost = false;
+}
+
+void Journal::record(uint8_t track, uint8_t field, uint8_t step, uint16_t old_value, uint16_t new_value){
+    if (applied < length) begin(); //edited after an undo without an explicit group
+    if (group_lost) return;
+
+    if (!group_pending) {
+        for (uint8_t i = length; i-- > group_first; ) { //a value changed again keeps its first old value
+            journal_entry &e = at(i);
+            if (e.getTrack() != track || e.getField() != field || e.getStep() != step) continue;
+            if (field == FIELD_ROTATE || field == FIELD_REVERSE) { //operations add up their argument instead
+                int16_t sum = (int8_t)e.old_value + (int8_t)old_value;
+                if (sum < -128 || sum > 127) break; //would wrap, the rest goes in a new entry of the group
+                e.old_value = sum;
+            } else {
+                e.new_value = new_value;
+                e.field = (e.field & ~0x40) | ((new_value >> 2) & 0x40);
+            }
+            return;
+        }
+    }
+
+    if (length == JOURNAL_LENGTH) {
+        if (group_first == 0) { //this group alone is bigger than the ring, it can't be undone
+            clear();
+            group_lost = true;
+            return;
+        }
+        dropOldestGroup();
+    }
+
+    journal_entry &e = at(length);
+    e.step = (step & 0x7F) | (group_pending ? 0x80 : 0);
+    e.field = field | ((old_value >> 3) & 0x20) | ((new_value >> 2) & 0x40) | (track << 7);
+    e.old_value = old_value;
+    e.new_value = new_value;
+    length++;
+    applied = length;
+    group_pending = false;
+}
+
+bool Journal::continues(uint8_t track, uint8_t field, uint8_t step){
+    if (group_lost || group_pending || applied != length || length == group_first) return false;
+    journal_entry &e = at(length - 1);
+    return e.getTrack() == track && e.getField() == field && e.getStep() == step;
+}
+
+uint8_t Journal::undo(){
+    uint8_t count = 0;
+    while (applied) {
+        applied--;
+        count++;
+        if (at(applied).step & 0x80) break;
+    }
+    return count;
+}
+
+uint8_t Journal::redo(){
+    uint8_t count = 0;
+    while (applied < length) {
+        applied++;
+        count++;
+        if (applied == length || (at(applied).step & 0x80)) break;
+    }
+    return count;
+}
+
+void Journal::forget(uint8_t track, uint8_t field){
+    uint8_t end = 0; //entries before this one go
+    for (uint8_t i = 0; i < length; i++) {
+        journal_entry &e = at(i);
+        if (e.getTrack() == track && e.getField() == field) end = i + 1;
+    }
+    if (!end) return;
+    while (end < length && !(at(end).step & 0x80)) end++; //along with the rest of its group
+    bool open_group_lost = group_first < end && group_first < length;
+    first += end;
+    if (first >= JOURNAL_LENGTH) first -= JOURNAL_LENGTH;
+    length -= end;
+    applied = applied > end ? applied - end : 0;
+    group_first = group_first > end ? group_first - end : 0;
+    if (open_group_lost) {
+        group_first = length;
+        group_pending = true; //further edits of the open group start a new one
+    }
+}
+
+bool Journal::lastIs(uint8_t track, uint8_t field){
+    if (!applied) return false;
+    journal_entry &e = at(applied - 1);
+    return e.getTrack() == track && e.getField() == field;
+}
+
+const journal_entry& Journal::entry(uint8_t index){
+    return at(index);
+}
+
+journal_entry& Journal::at(uint8_t index){ //ring slot of the entry index places after the oldest
+    uint8_t slot = first + index;
+    if (slot >= JOURNAL_LENGTH) slot -= JOURNAL_LENGTH;
+    return entries[slot];
+}
+
+void Journal::dropOldestGroup(){
+    do {
+        if (++first >= JOURNAL_LENGTH) first = 0;
+        length--;
+        applied--;
+        group_first--;
+    } while (length && !(at(0).step & 0x80));
+}
@@ -0,0 +1,130 @@
+#pragma once
+/**
+ * @file journal.h
+ * @brief Undo/redo history of sequence edits.
+ *
+ * Edits are kept as packed 4-byte diffs (track, step, field, old and new
+ * value) in a fixed ring rather than as copies of the sequence. Entries are
+ * grouped: one button press, one knob sweep or one bulk operation such as
+ * clear or paste undoes as a unit. When the ring is full the oldest whole
+ * groups are dropped. A group that can't fit at all is forgotten, along with
+ * everything before it, so undo never restores half an operation. Edits of a
+ * whole long track are kept as a snapshot by the sequencer instead.
+ *
+ * The journal only stores entries; the sequencer applies them.
+ */
+
+#include <stdint.h>
+
+// Per-step fields.
+const uint8_t FIELD_PITCH = 0;
+const uint8_t FIELD_OCTAVE = 1;
+const uint8_t FIELD_DURATION = 2;
+const uint8_t FIELD_CV = 3;
+const uint8_t FIELD_STEP = 4;
+const uint8_t FIELD_GLIDE = 5;
+const uint8_t FIELD_EFFECT = 6;
+const uint8_t FIELD_TRIG = 7;
+// Sequence parameters, the step is unused.
+const uint8_t FIELD_LENGTH = 8;
+const uint8_t FIELD_GLIDE_LENGTH = 9;
+const uint8_t FIELD_SCALE = 10;
+const uint8_t FIELD_EFFECT_TYPE = 11;
+const uint8_t FIELD_EFFECT_DEPTH = 12;
+const uint8_t FIELD_TRANSPOSE = 13;
+const uint8_t FIELD_CV_MODE = 14;
+const uint8_t FIELD_SWING = 15;
+const uint8_t FIELD_LANE_LENGTH = 16; // + lane index
+// Reversible operations stored as one entry, the step holds the argument.
+const uint8_t FIELD_ROTATE = 20;
+const uint8_t FIELD_REVERSE = 21;
+// Parameter locks, + LOCK_ parameter. 0x100 (LOCK_NONE) is an unlocked value.
+const uint8_t FIELD_LOCK = 22;
+// A whole track rewritten by a transform with too many values to journal, the step holds which
+// one. The sequencer keeps the track from before it in a snapshot, undo and redo swap the two.
+const uint8_t FIELD_TRANSFORM = 30;
+// A whole track cleared. The old values are kept by the sequencer in a snapshot, not in the entry.
+const uint8_t FIELD_CLEAR = 31;
+
+// 128 entries = 512 bytes of SRAM.
+const uint8_t JOURNAL_LENGTH = 128;
+
+struct journal_entry {
+    uint8_t step;      // bits 0-6 step, bit 7 first entry of a group
+    uint8_t field;     // bits 0-4 field, bits 5/6 hold bit 8 of the old/new value, bit 7 track
+    uint8_t old_value;
+    uint8_t new_value;
+
+    uint8_t getStep() const { return step & 0x7F; }
+    uint8_t getTrack() const { return field >> 7; }
+    uint8_t getField() const { return field & 0x1F; }
+    uint16_t getOldValue() const { return old_value | ((field & 0x20) << 3); }
+    uint16_t getNewValue() const { return new_value | ((field & 0x40) << 2); }
+};
+
+class Journal {
+public:
+    /**
+     * @brief Forget all history, e.g. when another patch is loaded.
+     */
+    void clear();
+
+    /**
+     * @brief Start a new group. Anything that could still be redone is dropped.
+     */
+    void begin();
+
+    /**
+     * @brief Record a change of one value (9 bits at most) in the current group.
+     * A value already changed in this group keeps its first old value.
+     */
+    void record(uint8_t track, uint8_t field, uint8_t step, uint16_t old_value, uint16_t new_value);
+
+    /**
+     * @brief True while the last group is still open on this same value, so a
+     * knob sweep keeps adding to one group instead of starting one per reading.
+     */
+    bool continues(uint8_t track, uint8_t field, uint8_t step);
+
+    /**
+     * @brief Step back over the newest applied group.
+     * @return Number of entries to revert, found at getApplied() onwards.
+     */
+    uint8_t undo();
+
+    /**
+     * @brief Step forward over the next undone group.
+     * @return Number of entries to apply again, found before getApplied().
+     */
+    uint8_t redo();
+
+    /**
+     * @brief Drop the oldest groups until none holds an entry of this field,
+     * e.g. once the snapshot a clear entry refers to is overwritten.
+     */
+    void forget(uint8_t track, uint8_t field);
+
+    /**
+     * @brief True if the newest applied entry is of this field.
+     */
+    bool lastIs(uint8_t track, uint8_t field);
+
+    uint8_t getApplied() { return applied; }
+
+    /**
+     * @brief Entry at a position counted from the oldest one.
+     */
+    const journal_entry& entry(uint8_t index);
+
+private:
+    journal_entry entries[JOURNAL_LENGTH];
+    uint8_t first = 0;        // ring position of the oldest entry
+    uint8_t length = 0;       // entries held
+    uint8_t applied = 0;      // entries not undone, the rest can be redone
+    uint8_t group_first = 0;  // position of the open group's first entry
+    bool group_pending = false; // next entry starts a group
+    bool group_lost = false;  // open group overflowed, ignore it until the next begin()
+
+    journal_entry& at(uint8_t index);
+    void dropOldestGroup();
+};
@@ -6,12 +6,34 @@
 #include "pinout.h"
 
 const uint32_t PATCH_FILE_SIZE = 4096;
-const int PATCH_SEQ_LENGTH = 64;
+const int PATCH_SEQ_LENGTH = 64; //steps per lane of the original layout
+const uint8_t PATCH_LENGTH_MARK = 0x80; //first byte of a patch with longer lanes, followed by their length. never a valid pitch
+const uint32_t SONG_FILE_SIZE = 256;
+const char SONG_FILE_NAME[] = "song.bin"; //patches are numbered, so this can't clash
 Sequencer *sequencerVar4;
 bool active = false;
 char filename[20] = "001.bin";
-uint8_t durations_8bit[128];
+char save_filename[20]; //latched by save(), finishSaving writes it once the flash has erased it
+bool save_pending = false;
+uint8_t lane_buffer[SEQUENCE_MAX_LENGTH]; //one lane of a track block, steps are packed in memory but not in the file
 SerialFlashFile file;
+bool saving_song = false; //finishSaving writes the song rather than a patch
+
+//settings of the track block being read, unpacked once the whole block is in
+uint8_t read_length = PATCH_SEQ_LENGTH; //steps per lane in the file being read
+uint8_t read_misc[8]; //unsigned
+int8_t read_misc2[4]; //signed
+uint8_t read_seed[2];
+uint8_t read_track_info[1];
+
+//the next song patch is read a part at a time into the sequencer's shadow banks
+const byte SEQUENCE_PARTS = 16; //reads per track block
+const byte PREFETCH_DONE = SEQUENCE_PARTS * TRACK_COUNT;
+SerialFlashFile prefetch_file;
+int prefetch_patch = 0; //0 = nothing prefetched
+byte prefetch_part = 0; //next part to read, counted across the track blocks
+byte prefetch_missing = 0; //bit per track whose block was never written
+bool prefetch_found = false; //a missing patch is remembered too, so it isn't looked up again every step
 
 bool Memory::init(Sequencer& sequencer){
     sequencerVar4 = &sequencer;
@@ -19,35 +41,54 @@ bool Memory::init(Sequencer& sequencer){
     if (!SerialFlash.begin(CSFLASH_PIN)){
         return false;
     } else {
+        loadSong();
         return true;
     }
 }
 
 void Memory::erase(){
      SerialFlash.eraseAll();
+     sequencerVar4->getSong().clear();
 }
 
 
 char* Memory::getFileName(int patch){
-    char filenum[4];
-    itoa(patch, filenum, 10);
-    memset(&filename[0], 0, sizeof(filename));
-    strcpy(filename, filenum);
-    strcat(filename, ".bin");
-    return filename;
+    return formatFileName(patch, filename);
+}
+
+char* Memory::formatFileName(int patch, char *name){ //name holds at least 8 chars
+    itoa(patch, name, 10);
+    strcat(name, ".bin");
+    return name;
 }
 
 byte Memory::save(int patch){ 
     if (SerialFlash.ready() == false) { //still erasing?
         return 0;
     }
-    getFileName(patch);
-    bool fileExists = SerialFlash.exists(filename);
+    if (patch == prefetch_patch) cancelPrefetch(); //the shadow copy is about to go stale
+    formatFileName(patch, save_filename);
+    saving_song = false;
+    return startSaving(PATCH_FILE_SIZE);
+}
+
+byte Memory::saveSong(){
+    if (SerialFlash.ready() == false) { //still erasing?
+        return 0;
+    }
+    strcpy(save_filename, SONG_FILE_NAME);
+    saving_song = true;
+    return startSaving(SONG_FILE_SIZE);
+}
+
+byte Memory::startSaving(uint32_t size){ //creates or erases save_filename, finishSaving writes it once the flash is ready
+    save_pending = true;
+    bool fileExists = SerialFlash.exists(save_filename);
     if (!fileExists) {  // true if the file exists
-        SerialFlash.createErasable(filename, PATCH_FILE_SIZE);
+        SerialFlash.createErasable(save_filename, size);
         return 1;
     } else {
-        file = SerialFlash.open(filename);
+        file = SerialFlash.open(save_filename);
         file.erase();
         return 2;
     }
@@ -57,16 +98,62 @@ bool Memory::finishSaving(){
     if (SerialFlash.ready() == false) { //still erasing?
         return false;
     }
-    sequence *seq = sequencerVar4->getSequence();
 
-    int8_t *pitches     =  seq->pitch_matrix;
-    int8_t *octaves     =  seq->octave_matrix;
-    uint16_t *durations =  seq->duration_matrix;
-    int8_t *cvs         =  seq->cv_matrix;
-    bool *steps         =  seq->step_matrix;
-    bool *glides        =  seq->glide_matrix;
-    bool *effects       =  seq->effect_matrix;
+    //SerialFlashFile file;
+    if (file) file.close();
+    file = SerialFlash.open(save_filename);
+    save_pending = false;
+
+    if (saving_song) {
+        Song &song = sequencerVar4->getSong();
+        for (byte i = 0; i < SONG_LENGTH; i++) {
+            file.write(&song.entry(i), sizeof(song_entry));
+        }
+    } else {
+        uint8_t length = storedLength();
+        if (length > PATCH_SEQ_LENGTH) { //shorter patches keep the original layout, which older firmware reads too
+            uint8_t header[2] = { PATCH_LENGTH_MARK, length };
+            file.write(header, sizeof(header));
+        }
+        for (byte t = 0; t < TRACK_COUNT; t++) { //one block per track, the first keeps the original single-track layout
+            writeSequence(sequencerVar4->getTrackSequence(t), length);
+        }
+    }
+
+    file.close();
+    return 1;
+
+}
+
+uint8_t Memory::storedLength(){ //steps per lane to save, rounded up to whole bars. steps past the longest lane are dropped
+    uint8_t longest = 0;
+    for (byte t = 0; t < TRACK_COUNT; t++) {
+        sequence *seq = sequencerVar4->getTrackSequence(t);
+        longest = max(longest, seq->sequence_length);
+        for (byte i = 0; i < LANE_COUNT; i++) {
+            longest = max(longest, seq->lane_length[i]);
+        }
+    }
+    if (longest <= PATCH_SEQ_LENGTH) return PATCH_SEQ_LENGTH;
+    return (longest + 15) & ~15;
+}
+
+void Memory::writeLane(sequence *seq, uint8_t field, uint8_t length){ //gathers one field of the packed steps into a lane
+    for (byte i = 0; i < length; i++) {
+        step_data &step = seq->steps[i];
+        switch (field) {
+            case FIELD_PITCH:  lane_buffer[i] = step.pitch; break;
+            case FIELD_OCTAVE: lane_buffer[i] = step.octave; break;
+            case FIELD_CV:     lane_buffer[i] = step.cv; break;
+            case FIELD_STEP:   lane_buffer[i] = step.gate; break;
+            case FIELD_GLIDE:  lane_buffer[i] = step.glide; break;
+            case FIELD_EFFECT: lane_buffer[i] = step.effect; break;
+        }
+    }
+    file.write(lane_buffer, length);
+}
 
+void Memory::writeSequence(sequence *seq, uint8_t length){
     uint8_t misc[8]; //unsigned
     misc[0] = seq->glide_length;
 	misc[1] = seq->sequence_length;
@@ -79,72 +166,200 @@ bool Memory::finishSaving(){
 
     int8_t misc2[4]; //signed
     misc2[0] = seq->transpose;
-    misc2[1] = seq->song_next_seq;
-    misc2[2] = seq->song_loops;
+    misc2[1] = 0; //was the song chain, now kept in the song file
+    misc2[2] = 0;
     misc2[3] = seq->cv_mode;
 
+    uint8_t seed[2];
+    seed[0] = (seq->random_seed & 0xFF00) >> 8;
+    seed[1] = seq->random_seed & 0x00FF;
 
-    for(int i = 0; i<PATCH_SEQ_LENGTH; i++){ //split 16-bit numbers into 2 bytes
-        durations_8bit[i] = (durations[i] & 0xFF00) >> 8;
-        durations_8bit[i+PATCH_SEQ_LENGTH] = durations[i] & 0x00FF;
-    }
-
+    uint8_t track_info[1];
+    track_info[0] = seq->clock_division;
 
-    //SerialFlashFile file;
-    if (file) file.close();
-    file = SerialFlash.open(filename);
+    uint8_t *lanes      =  seq->lane_length;
 
-    file.write(pitches, PATCH_SEQ_LENGTH);
-    file.write(octaves, PATCH_SEQ_LENGTH);
-    file.write(durations_8bit, PATCH_SEQ_LENGTH*2);
-    file.write(cvs, PATCH_SEQ_LENGTH);
-    file.write(steps, PATCH_SEQ_LENGTH);
-    file.write(glides, PATCH_SEQ_LENGTH);
+    writeLane(seq, FIELD_PITCH, length);
+    writeLane(seq, FIELD_OCTAVE, length);
+    for(int i = 0; i<length; i++){ //split 16-bit numbers into 2 bytes, high bytes first
+        lane_buffer[i] = seq->steps[i].duration >> 8;
+    }
+    file.write(lane_buffer, length);
+    for(int i = 0; i<length; i++){
+        lane_buffer[i] = seq->steps[i].duration & 0x00FF;
+    }
+    file.write(lane_buffer, length);
+    writeLane(seq, FIELD_CV, length);
+    writeLane(seq, FIELD_STEP, length);
+    writeLane(seq, FIELD_GLIDE, length);
     file.write(misc, sizeof(misc));
     file.write(misc2, sizeof(misc2));
-    file.write(effects, PATCH_SEQ_LENGTH);
-
-    file.close();
-    return 1;
-
+    writeLane(seq, FIELD_EFFECT, length);
+    file.write(seed, sizeof(seed));
+    file.write(track_info, sizeof(track_info));
+    file.write(lanes, LANE_COUNT);
+    file.write(seq->trig_matrix, length);
+    file.write(seq->lock_steps, length / 8);
+    file.write(seq->locks, sizeof(seq->locks)); //whole table, so every block keeps the same size
+    file.write(seq->motion, sizeof(seq->motion));
 }
 
 
 bool Memory::load(int patch){
+    cancelPrefetch(); //shares the read buffers, and a patch picked by hand replaces the next one anyway
     getFileName(patch);
     if (file) file.close();
     file = SerialFlash.open(filename);
     if (!file) {  // true if the file exists
         return false; //TODO load blank patch?
     }
+    read_length = readStoredLength(file);
 
-    sequence *seq = sequencerVar4->getSequence();
-    //sequence *seq = &seq2;
-    
-    int8_t *pitches     =  seq->pitch_matrix;
-    int8_t *octaves     =  seq->octave_matrix;
-    uint16_t *durations =  seq->duration_matrix;
-    int8_t *cvs         =  seq->cv_matrix;
-    bool *steps         =  seq->step_matrix;
-    bool *glides        =  seq->glide_matrix;
-    bool *effects       =  seq->effect_matrix;
-    uint8_t misc[8]; //unsigned    
-    int8_t misc2[4]; //signed
+    byte missing = 0;
+    for (byte t = 0; t < TRACK_COUNT; t++) {
+        if (!readSequence(sequencerVar4->getTrackSequence(t))) {
+            missing |= 1 << t;
+        }
+    }
+    setupLoadedPatch(missing);
+
+    file.close();
+    return true;
+}
+
+bool Memory::prefetch(int patch){
+    if (patch == prefetch_patch) return prefetch_found;
+    if (save_pending || SerialFlash.ready() == false) return false; //busy erasing for a save, asked again on the next step
+    cancelPrefetch();
+    if (patch <= 0) return false;
+    char name[8];
+    prefetch_file = SerialFlash.open(formatFileName(patch, name));
+    prefetch_patch = patch;
+    prefetch_found = prefetch_file;
+    if (prefetch_found) read_length = readStoredLength(prefetch_file);
+    prefetch_part = prefetch_found ? 0 : PREFETCH_DONE;
+    prefetch_missing = 0;
+    return prefetch_found;
+}
+
+void Memory::pollPrefetch(){
+    if (prefetch_patch == 0 || prefetch_part == PREFETCH_DONE) return;
+    if (SerialFlash.ready() == false) return; //erasing for a save
 
+    byte t = prefetch_part / SEQUENCE_PARTS;
+    byte part = prefetch_part % SEQUENCE_PARTS;
+    sequence *seq = sequencerVar4->getShadowSequence(t);
+    readPart(prefetch_file, seq, part);
+    if (part == SEQUENCE_PARTS - 1 && !unpackSequence(seq)) {
+        prefetch_missing |= 1 << t;
+    }
+    if (++prefetch_part == PREFETCH_DONE) {
+        prefetch_file.close();
+    }
+}
+
+bool Memory::takePrefetched(int patch){
+    if (patch != prefetch_patch || prefetch_part != PREFETCH_DONE || !prefetch_found) {
+        return false; //not read in time, the caller loads it the slow way
+    }
+    sequencerVar4->swapSequences();
+    setupLoadedPatch(prefetch_missing);
+    prefetch_patch = 0;
+    return true;
+}
+
+void Memory::cancelPrefetch(){
+    if (prefetch_file) prefetch_file.close();
+    prefetch_patch = 0;
+    prefetch_found = false;
+}
+
+void Memory::setupLoadedPatch(byte missing){
+    for (byte t = 0; t < TRACK_COUNT; t++) {
+        if (missing & (1 << t)) {
+            //block never written (patch saved with fewer tracks), bytes still erased
+            sequencerVar4->clearTrack(t);
+            sequencerVar4->getTrackSequence(t)->clock_division = t == 0 ? 1 : 0;
+        }
+    }
+
+    sequencerVar4->setTempoFromSequence();
+    sequencerVar4->pickupPositionInNewSequence();
+    sequencerVar4->restartRandom();
+    sequencerVar4->rebuildPitchPool();
+    sequencerVar4->clearHistory(); //edits of the previous patch can't be undone into this one
+}
+
+bool Memory::readSequence(sequence *seq){
+    for (byte part = 0; part < SEQUENCE_PARTS; part++) {
+        readPart(file, seq, part);
+    }
+    return unpackSequence(seq);
+}
+
+uint8_t Memory::readStoredLength(SerialFlashFile &f){ //patches of up to 64 steps have no header
+    uint8_t header[2];
+    f.read(header, 1);
+    if (header[0] != PATCH_LENGTH_MARK) {
+        f.seek(0);
+        return PATCH_SEQ_LENGTH;
+    }
+    f.read(header + 1, 1);
+    return min(header[1], SEQUENCE_MAX_LENGTH);
+}
+
+void Memory::readLane(SerialFlashFile &f, sequence *seq, uint8_t field){ //scatters one lane of the file into the packed steps
+    f.read(lane_buffer, read_length);
+    for (byte i = 0; i < read_length; i++) {
+        step_data &step = seq->steps[i];
+        switch (field) {
+            case FIELD_PITCH:  step.pitch = (int8_t)lane_buffer[i]; break;
+            case FIELD_OCTAVE: step.octave = (int8_t)lane_buffer[i]; break;
+            case FIELD_CV:     step.cv = (int8_t)lane_buffer[i]; break;
+            case FIELD_STEP:   step.gate = lane_buffer[i] != 0; break;
+            case FIELD_GLIDE:  step.glide = lane_buffer[i] != 0; break;
+            case FIELD_EFFECT: step.effect = lane_buffer[i] != 0; break;
+        }
+    }
+}
 
-    file.read(pitches, PATCH_SEQ_LENGTH);
-    file.read(octaves, PATCH_SEQ_LENGTH);
-    file.read(durations_8bit, PATCH_SEQ_LENGTH*2);
-    file.read(cvs, PATCH_SEQ_LENGTH);
-    file.read(steps, PATCH_SEQ_LENGTH);
-    file.read(glides, PATCH_SEQ_LENGTH);
-    file.read(misc, sizeof(misc));
-    file.read(misc2, sizeof(misc2));
-    file.read(effects, PATCH_SEQ_LENGTH);
-    
-    for(int i = 0; i<PATCH_SEQ_LENGTH; i++){ //expand bytewise chars to 16-bit number
-        durations[i] = durations_8bit[i] * 256 + durations_8bit[i+PATCH_SEQ_LENGTH];
+void Memory::readPart(SerialFlashFile &f, sequence *seq, byte part){ //one read of a track block, in file order
+    switch (part) {
+        case 0:  readLane(f, seq, FIELD_PITCH); break;
+        case 1:  readLane(f, seq, FIELD_OCTAVE); break;
+        case 2:
+            f.read(lane_buffer, read_length); //high bytes, then low bytes
+            for(int i = 0; i<read_length; i++){
+                seq->steps[i].duration = lane_buffer[i] << 8;
+            }
+            f.read(lane_buffer, read_length);
+            for(int i = 0; i<read_length; i++){
+                seq->steps[i].duration = seq->steps[i].duration | lane_buffer[i];
+            }
+            break;
+        case 3:  readLane(f, seq, FIELD_CV); break;
+        case 4:  readLane(f, seq, FIELD_STEP); break;
+        case 5:  readLane(f, seq, FIELD_GLIDE); break;
+        case 6:  f.read(read_misc, sizeof(read_misc)); break;
+        case 7:  f.read(read_misc2, sizeof(read_misc2)); break;
+        case 8:  readLane(f, seq, FIELD_EFFECT); break;
+        case 9:  f.read(read_seed, sizeof(read_seed)); break;
+        case 10: f.read(read_track_info, sizeof(read_track_info)); break;
+        case 11: f.read(seq->lane_length, LANE_COUNT); break;
+        case 12: f.read(seq->trig_matrix, read_length); break;
+        case 13: f.read(seq->lock_steps, read_length / 8); break;
+        case 14: f.read(seq->locks, sizeof(seq->locks)); break;
+        case 15: f.read(seq->motion, sizeof(seq->motion)); break;
     }
+}
+
+bool Memory::unpackSequence(sequence *seq){ //settings and sanity checks once a whole block is read
+    uint8_t *trigs      =  seq->trig_matrix;
+    uint8_t *misc       =  read_misc;
+    int8_t *misc2       =  read_misc2;
+    uint8_t *seed       =  read_seed;
+    uint8_t *track_info =  read_track_info;
+    uint8_t *lanes      =  seq->lane_length;
 
     seq->glide_length     = misc[0];
 	seq->sequence_length  = misc[1];
@@ -156,20 +371,73 @@ bool Memory::load(int patch){
     seq->sequence_tempo   = misc[7];
 
     seq->transpose        = misc2[0];
-    seq->song_next_seq    = misc2[1];
-    seq->song_loops       = misc2[2];
     seq->cv_mode          = misc2[3];
-    
-    sequencerVar4->setTempoFromSequence();
-    sequencerVar4->pickupPositionInNewSequence();
 
+    seq->random_seed      = seed[0] * 256 + seed[1];
+    if (seq->random_seed == 0xFFFF) { //patch saved before seeds were stored, bytes still erased
+        seq->random_seed = PRNG_DEFAULT_SEED;
+    }
+
+    for (int i = 0; i < read_length; i++) {
+        if (trigs[i] == 0xFF) trigs[i] = 0; //erased, saved before steps had conditions
+    }
+    for (int i = read_length; i < SEQUENCE_MAX_LENGTH; i++) { //past the saved lanes, as a cleared step
+        seq->steps[i] = step_data();
+        seq->steps[i].duration = 80;
+        trigs[i] = 0;
+    }
+    memset(seq->lock_steps + read_length / 8, 0, (SEQUENCE_MAX_LENGTH - read_length) / 8);
+
+    for (byte i = 0; i < LANE_COUNT; i++) {
+        if (lanes[i] > read_length) lanes[i] = 0; //erased, saved before lanes had their own length
+    }
+
+    seq->lock_count = 0;
+    for (byte i = 0; i < sizeof(seq->lock_steps); i++) {
+        seq->lock_count += __builtin_popcount(seq->lock_steps[i]);
+    }
+    if (seq->lock_count > LOCK_SLOTS) { //erased, saved before steps had parameter locks
+        memset(seq->lock_steps, 0, sizeof(seq->lock_steps));
+        seq->lock_count = 0;
+    }
+
+    for (int i = 0; i < MOTION_STEPS; i++) { //erased, saved before motion recording
+        motion_step &motion = seq->motion[i];
+        if (motion.key == -1 && motion.deltas[0] == 0xFF && motion.deltas[1] == 0xFF && motion.deltas[2] == 0xFF && motion.deltas[3] == 0xFF) {
+            motion.key = MOTION_NONE;
+        }
+    }
+
+    if (track_info[0] == 0xFF) { //saved before tracks had their own clock division
+        seq->clock_division = 1;
+        return misc[1] != 0xFF; //an erased length means the whole block was never written
+    }
+    seq->clock_division = track_info[0];
+    return true;
+}
+
+bool Memory::loadSong(){
+    Song &song = sequencerVar4->getSong();
+    song.clear();
+    if (file) file.close();
+    file = SerialFlash.open(SONG_FILE_NAME);
+    if (!file) {
+        return false; //no song saved yet
+    }
 
+    for (byte i = 0; i < SONG_LENGTH; i++) {
+        song_entry &e = song.entry(i);
+        file.read(&e, sizeof(song_entry));
+        if (e.patch > SONG_MAX_PATCH || e.repeats == 0 || e.repeats > SONG_MAX_REPEATS || abs(e.transpose) > SONG_MAX_TRANSPOSE) {
+            e = song_entry(); //erased, past the end of the song when it was saved
+        }
+    }
 
     file.close();
     return true;
 }
 
 bool Memory::patchExists(int patch){
-    getFileName(patch);
-    return SerialFlash.exists(filename);
+    char name[8]; //leaves save_filename to a save still being erased
+    return SerialFlash.exists(formatFileName(patch, name));
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 #include <Arduino.h>
 #include <SerialFlash.h>
 
-#include "Sequencer.h"
+#include "sequencer.h"
 
 class Memory{
     public:
@@ -13,6 +13,12 @@ class Memory{
         bool finishSaving();
         bool load(int patch);
         bool patchExists(int patch);
+        byte saveSong();
+        bool loadSong();
+        bool prefetch(int patch);
+        void pollPrefetch();
+        bool takePrefetched(int patch);
+        void cancelPrefetch();
 
         bool saveSerialized(byte patch);
         void erase();
@@ -28,5 +34,16 @@ class Memory{
         uint32_t getChipId();
         uint32_t getChipSize();
     private:
+        char* formatFileName(int patch, char *name);
         uint32_t getPatchAddress(byte patch);
+        byte startSaving(uint32_t size);
+        uint8_t storedLength();
+        void writeLane(sequence *seq, uint8_t field, uint8_t length);
+        void writeSequence(sequence *seq, uint8_t length);
+        bool readSequence(sequence *seq);
+        uint8_t readStoredLength(SerialFlashFile &f);
+        void readLane(SerialFlashFile &f, sequence *seq, uint8_t field);
+        void readPart(SerialFlashFile &f, sequence *seq, byte part);
+        bool unpackSequence(sequence *seq);
+        void setupLoadedPatch(byte missing);
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 // MISC PINS
 #define GATE_PIN                9
+#define GATE2_PIN               8   //gate of the second track
 //#define LDAC_PIN 1
 #define CLOCK_OUT_PIN           53
 #define CLOCK_IN_PIN            52
@@ -65,10 +66,13 @@ const int buttonCols[8] = { COL0_PIN, COL1_PIN, COL2_PIN, COL3_PIN,
 #define ANALOG_PIN_3            A2
 #define ANALOG_PIN_4            A3
 
+// CV INPUT PINS - modulation sources, scanned with the pots
+#define CV_IN_1_PIN             A6
+#define CV_IN_2_PIN             A7
+
 // ENCODER PINS
 #define ENC_A_PIN               A4
 #define ENC_B_PIN               A5
-#define ENC_PORT                PINC
 
 // GAIN
 #define GAIN_1                  0x1
@@ -0,0 +1,56 @@
+#pragma once
+/**
+ * @file prng.h
+ * @brief Small seedable pseudo-random generator for the generative effects.
+ *
+ * 16-bit xorshift (shift triple 7/9/8, period 65535). Each call costs a few
+ * shifts and XORs on the AVR, and ranges are mapped with an 8x8 multiply
+ * instead of the 16/32-bit divisions behind rand() % n. Given the same seed
+ * the generator always produces the same stream, so generative patterns can
+ * be replayed after a patch is reloaded.
+ */
+
+#include <stdint.h>
+
+// Seed used when none (or an invalid one) is stored in a patch.
+const uint16_t PRNG_DEFAULT_SEED = 0xACE1;
+
+class Prng {
+public:
+    /**
+     * @brief Restart the stream from a seed. Zero would lock xorshift at zero,
+     * so it is replaced by the default seed.
+     */
+    void seed(uint16_t seed) {
+        state = seed ? seed : PRNG_DEFAULT_SEED;
+    }
+
+    /**
+     * @brief Advance the generator and return the next 16-bit value.
+     */
+    uint16_t next() {
+        state ^= state << 7;
+        state ^= state >> 9;
+        state ^= state << 8;
+        return state;
+    }
+
+    /**
+     * @brief Uniform value in [0, n) for n in 1..255, without division.
+     */
+    uint8_t range(uint8_t n) {
+        return ((uint16_t)(next() >> 8) * n) >> 8;
+    }
+
+    /**
+     * @brief Return true with the given chance out of 256.
+     */
+    bool chance(uint8_t threshold) {
+        return (uint8_t)(next() >> 8) < threshold;
+    }
+
+    uint16_t getState() { return state; }
+
+private:
+    uint16_t state = PRNG_DEFAULT_SEED;
+};
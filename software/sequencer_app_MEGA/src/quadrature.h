@@ -0,0 +1,59 @@
+#pragma once
+/**
+ * @file quadrature.h
+ * @brief Encoder arithmetic that doesn't touch the hardware: decoding the
+ * quadrature states, counting them into detents and the acceleration of fast
+ * turns.
+ *
+ * The timer interrupt samples the pins and Encoder::poll reads the count, both
+ * through these functions, so the same code runs in the native tests.
+ */
+
+#include <stdint.h>
+
+//detents per second above which each detent counts for more, see Encoder::accelerate()
+const uint8_t ENCODER_ACCEL_SPEED = 8;
+const uint8_t ENCODER_MAX_ACCEL = 8;
+const uint8_t ENCODER_STEPS_PER_DETENT = 4;
+
+//magic numbers from https://www.circuitsathome.com/mcu/reading-rotary-encoder-on-arduino/
+const int8_t enc_states[] = { 0,-1,1,0,1,0,0,-1,-1,0,0,1,0,1,-1,0 };
+
+/**
+ * @brief Decode one sample of the A and B pins.
+ * @param history The previous sample in bits 2-3, kept between calls.
+ * @return +1 or -1 for a valid transition, 0 for none or a skipped state.
+ */
+inline int8_t quadratureStep(uint8_t &history, bool a, bool b) {
+    history = (history << 2 | a | b << 1) & 0x0f;
+    return enc_states[history];
+}
+
+/**
+ * @brief Add a transition to the count, which sticks at the ends of int8_t
+ * rather than wrapping into a turn the other way when polls are far apart.
+ */
+inline int8_t addSteps(int8_t steps, int8_t step) {
+    int16_t sum = steps + step;
+    return sum > 127 ? 127 : sum < -128 ? -128 : sum;
+}
+
+/**
+ * @brief Whole detents in the transitions counted so far.
+ * @param remainder Transitions short of a detent, carried to the next call.
+ */
+inline int takeDetents(int &remainder, int steps) {
+    remainder += steps;
+    int detents = remainder / ENCODER_STEPS_PER_DETENT; //encoder detent is too coarse for 1-per step granularity
+    remainder -= detents * ENCODER_STEPS_PER_DETENT;
+    return detents;
+}
+
+/**
+ * @brief Factor for accelerate(), from detents turned in the time since the last ones.
+ */
+inline uint8_t detentAcceleration(int detents, unsigned long elapsed_ms) {
+    unsigned long speed = (unsigned long)(detents < 0 ? -detents : detents) * 1000UL / (elapsed_ms ? elapsed_ms : 1UL); //detents per second
+    speed /= ENCODER_ACCEL_SPEED;
+    return speed < 1 ? 1 : speed > ENCODER_MAX_ACCEL ? ENCODER_MAX_ACCEL : speed;
+}
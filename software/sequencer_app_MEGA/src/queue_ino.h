@@ -1,67 +1,84 @@
 
-
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <stdlib.h>
 #include <stdint.h>
+#include <util/atomic.h>
 
 /*
-A very simple circular buffer.
+A single-producer/single-consumer ring of timestamped events.
 
 Example:
-QUEUE(test, int, count)
+EventQueue<uint16_t, 16> events;
 
-Creates:
-struct queue_test {...};
-static inline void queue_test_init(struct queue_test *) {...}
-static inline int queue_test_push(struct queue_test *, int *) {...}
-static inline int queue_test_pop(struct queue_test *, int *) {...}
+events.push(value, micros()); // producer, e.g. an interrupt
+events.pop(value, time);      // consumer, e.g. the loop
 
-API:
-queue_*_init initializes a queue
-queue_*_push pushes an item onto the queue, returns 0 if successful, not 0 if fail
-queue_*_pop pops an item from the queue, returns 0 if successful, not 0 if fail
+The producer only writes head and the consumer only writes tail, so neither
+side needs to disable interrupts: both indices are single bytes, which the AVR
+reads and writes atomically. They run freely from 0 to 255 and are masked into
+the ring, so Size must be a power of two no larger than 128.
+
+A push onto a full queue is dropped and counted. The most events ever waiting
+at once is kept as the high-water mark, to size the queue from.
 
+API:
+push adds an event, returns true if successful, false if the queue was full
+pop removes the oldest event, returns true if successful, false if empty
 */
 
-#define QUEUE(name, type, size) \
-struct queue_##name { \
-    type storage[size]; \
-    /*index of the read head, initialy 0*/ \
-    size_t read; \
-    /*index of the write head, initialy 0*/ \
-    size_t write; \
-    /*number of items in the queue*/ \
-    size_t count; \
-}; \
-static inline void queue_##name##_init(volatile struct queue_##name *q) { \
-    q->read = 0; \
-    q->write = 0; \
-    q->count = 0; \
-} \
-static inline int queue_##name##_push(volatile struct queue_##name *q, const volatile type *item) { \
-    if (q->count < size) { \
-        size_t next = (q->write + 1) % size; \
-        q->storage[next] = *item; \
-        q->write = next; \
-        q->count++; \
-        return 0; \
-    } else { \
-        return -1; \
-    }\
-} \
-static inline int queue_##name##_pop(volatile struct queue_##name *q, volatile type *item) { \
-    if (q->count > 0) { \
-        uint8_t next = (q->read + 1) % size; \
-        *item = q->storage[next]; \
-        q->read = next; \
-        q->count--; \
-        return 0; \
-    } else { \
-        return -1; \
-    } \
-}
-
-
-#endif //QUEUE_H
\ No newline at end of file
+template <typename T, uint8_t Size>
+class EventQueue {
+    static_assert(Size && !(Size & (Size - 1)) && Size <= 128, "EventQueue size must be a power of two up to 128");
+
+public:
+    bool push(const T &item, uint32_t time) {
+        uint8_t count = head - tail;
+        if (count == Size) {
+            drops++;
+            return false;
+        }
+        uint8_t slot = head & (Size - 1);
+        items[slot] = item;
+        times[slot] = time;
+        asm volatile("" ::: "memory"); // the slot is written before it is published
+        head++;
+        if (count + 1 > high_water) high_water = count + 1;
+        return true;
+    }
+
+    bool pop(T &item, uint32_t &time) {
+        if (head == tail) {
+            return false;
+        }
+        uint8_t slot = tail & (Size - 1);
+        item = items[slot];
+        time = times[slot];
+        asm volatile("" ::: "memory"); // the slot is read before it is handed back
+        tail++;
+        return true;
+    }
+
+    bool isEmpty() const { return head == tail; }
+
+    // Pushes refused because the queue was full.
+    uint16_t getDrops() const {
+        uint16_t count;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { // written by the producer, two bytes
+            count = drops;
+        }
+        return count;
+    }
+
+    uint8_t getHighWater() const { return high_water; }
+
+private:
+    T items[Size];
+    uint32_t times[Size]; // micros() of each event
+    volatile uint8_t head = 0; // next slot to push, producer only
+    volatile uint8_t tail = 0; // next slot to pop, consumer only
+    volatile uint16_t drops = 0;
+    volatile uint8_t high_water = 0;
+};
+
+#endif //QUEUE_H
@@ -64,6 +64,56 @@ static const uint8_t EFFECT_VIBRATO   = 16;
 
 const char *const effect_names[] PROGMEM = { effect_0, effect_1, effect_2, effect_3, effect_4, effect_5, effect_6, effect_7, effect_8, effect_9, effect_10, effect_11, effect_12, effect_13, effect_14, effect_15, effect_16 };
 
+const char trig_0[] PROGMEM = "ALL"; //every pass
+const char trig_1[] PROGMEM = "1 2"; //first of every 2 passes
+const char trig_2[] PROGMEM = "2 2";
+const char trig_3[] PROGMEM = "1 3";
+const char trig_4[] PROGMEM = "2 3";
+const char trig_5[] PROGMEM = "3 3";
+const char trig_6[] PROGMEM = "1 4";
+const char trig_7[] PROGMEM = "2 4";
+const char trig_8[] PROGMEM = "3 4";
+const char trig_9[] PROGMEM = "4 4";
+const char trig_10[] PROGMEM = "FST"; //first pass after reset
+const char trig_11[] PROGMEM = "NFS"; //not first pass
+const char trig_12[] PROGMEM = "FIL"; //while fill is held
+const char trig_13[] PROGMEM = "NFL"; //while fill is not held
+
+static const uint8_t TRIG_ALWAYS    = 0;
+static const uint8_t TRIG_4_4       = 9; //1..9 are the pass ratios, in trig_loop_masks order
+static const uint8_t TRIG_FIRST     = 10;
+static const uint8_t TRIG_NOT_FIRST = 11;
+static const uint8_t TRIG_FILL      = 12;
+static const uint8_t TRIG_NOT_FILL  = 13;
+
+static const uint8_t TRIG_LOOP_CYCLE = 12; //passes are counted modulo 12, which every ratio divides
+const uint16_t trig_loop_masks[9] PROGMEM = { 0x555, 0xAAA, 0x249, 0x492, 0x924, 0x111, 0x222, 0x444, 0x888 }; //bit n = fires on pass n
+
+const char *const trig_names[] PROGMEM = { trig_0, trig_1, trig_2, trig_3, trig_4, trig_5, trig_6, trig_7, trig_8, trig_9, trig_10, trig_11, trig_12, trig_13 };
+
+const char arp_0[] PROGMEM = "UP "; //up
+const char arp_1[] PROGMEM = "DN "; //down
+const char arp_2[] PROGMEM = "UPD"; //up-down
+const char arp_3[] PROGMEM = "RND"; //random
+const char arp_4[] PROGMEM = "PLY"; //as played
+
+const char *const arp_names[] PROGMEM = { arp_0, arp_1, arp_2, arp_3, arp_4 };
+
+const char mod_source_0[] PROGMEM = "OFF";
+const char mod_source_1[] PROGMEM = "IN1"; //cv inputs
+const char mod_source_2[] PROGMEM = "IN2";
+
+const char *const mod_source_names[] PROGMEM = { mod_source_0, mod_source_1, mod_source_2 };
+
+const char mod_destination_0[] PROGMEM = "TRN"; //in LOCK_ order, then the cv lane
+const char mod_destination_1[] PROGMEM = "GLD";
+const char mod_destination_2[] PROGMEM = "EFF";
+const char mod_destination_3[] PROGMEM = "DEP";
+const char mod_destination_4[] PROGMEM = "SWG";
+const char mod_destination_5[] PROGMEM = "CV2";
+
+const char *const mod_destination_names[] PROGMEM = { mod_destination_0, mod_destination_1, mod_destination_2, mod_destination_3, mod_destination_4, mod_destination_5 };
+
 const char note_0[] PROGMEM = "C 0";
 const char note_1[] PROGMEM = "Db0";
 const char note_2[] PROGMEM = "D 0";
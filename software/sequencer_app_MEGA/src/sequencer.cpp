@@ -5,81 +5,92 @@
 #include "calibrate.h"
 #include "sequencer.h"
 #include "scales.h"
+#include "journal.h"
 #include <elapsedMillis.h>
 
-const byte SEQUENCE_MAX_LENGTH = 64;
+track tracks[TRACK_COUNT];
+sequence sequence_banks[TRACK_COUNT][2]; //pointed to by track.seq, swapped when a prefetched pattern takes over
+const uint8_t track_gate_pins[TRACK_COUNT] = { GATE_PIN, GATE2_PIN };
+uint8_t edit_track = 0; //track edited by the step keys and pots
+uint8_t track_snapshots = 0; //bit per track whose shadow bank holds the track from before a clear or a transform
 
-sequence active_sequence;
+const uint8_t TRANSFORM_JOURNAL_LIMIT = JOURNAL_LENGTH / 4; //values a transform journals one by one, more take a snapshot
+const uint8_t TRANSFORM_NOTES = 0; //which transform a FIELD_TRANSFORM entry stands for
+const uint8_t TRANSFORM_EUCLID = 1;
 
-int8_t step_presets[] = { 4, 8, 12, 16, 24, 32, 48, 64 };
-int8_t active_pitches[64];
-int num_active_pitches = 0;
+uint8_t step_presets[] = { 4, 8, 12, 16, 24, 32, 48, 64, 96, 128 };
 
 int selected_step = 0;
-int8_t clock_step = -1;
-int8_t current_step = -1;
-int8_t active_step = -1;
-int8_t step_recording_initiated_step = 0;
+int8_t clock_tick = -1; //parity of the base clock, used for swing
+int16_t step_recording_initiated_step = 0;
+uint8_t step_recording_duration_step = 0; //duration lane position of the step being recorded
 
-uint8_t prev_sequence_length = active_sequence.sequence_length;
-uint8_t repeat_step_origin = 0;
 //uint8_t repeat_step_counter = 0;
 
-bool gate_active = false;
 bool clock_out_active = false;
 bool clock_in_active = false;
 bool reset_in_active = false;
 bool step_incremented = false;
 bool step_recording_mode = false;
 bool first_step = true;
-bool song_mode = false;
-int song_mode_loops = 0;
+int song_mode_loops = 0; //passes of the first track through the playing song entry
 bool time_for_next_sequence = false;
+bool switch_aligned = false; //the next sequence comes in on a bar line, so no need to guess where to pick it up
+bool switch_queued = false; //a pattern picked by hand waits for the next switch boundary
+uint8_t switch_quantize = SWITCH_PATTERN;
+uint8_t phrase_bar = 3; //bar of the first track within 4, 0 from its first step
+
+uint16_t arp_keys = 0; //bit per held step key
+uint8_t arp_order[16]; //held keys in the order they went down
+uint8_t arp_key_count = 0;
+uint8_t arp_mode = ARP_UP;
+uint8_t arp_octaves = 1;
+int8_t arp_position = -1; //index into the held keys repeated over arp_octaves
+int8_t arp_direction = 1; //for ARP_UP_DOWN
 
 byte tempo_bpm = 120;
 unsigned int tempo_millis = 15000 / tempo_bpm; //would be 60000 but we count 4 steps per "beat"
 bool play_active = 0;
-bool seq_effect_mode = false;
 bool seq_record_mode = false;
 bool seq_recording_effect = false;
+bool motion_recording = false; //cv2 knob moved during this recording pass
+int8_t motion_input = 0;
+mod_route mod_routes[MOD_ROUTES];
+uint8_t mod_routes_edited = 0; //bit per route changed since the routes were written to EEPROM
+uint8_t mod_inputs[MOD_INPUTS]; //latest cv input readings, 0-255
 bool mutate_button = false;
+bool fill_active = false; //held from the panel, satisfies the FIL trig condition
 
-bool current_scale_tones[13];
-bool note_reached;
 bool skip_next_external_step = false;
 bool count_next_swing_step = false;
 char pitchname[10];
 
-int prev_note = 0;
-int prev_note2 = 0;
-int active_note = 0;
-int active_note2 = 0;//for cv2
 int active_pitch = 0;
 int calculated_tempo = tempo_millis;
-unsigned int calculated_step_length = 10;
 unsigned int audition_step_length = 0;
-unsigned int calculated_roll;
-unsigned int calculated_stutter;
 double tempo_millis_swing_odd;
 double tempo_millis_swing_even;
-int glide_duration = 50;
-int glide_time; //
-int random_octave = 0;
-bool turing_mode = false;
 bool auditioning = false;
 
-double current_note_value = 0;
-double current_note_value2 = 0; // for cv2 in quantized mode
 double current_lfo_value = 0;
-double lfo_target = 0;
-double lfo_prev = 0;
-double lfo_time = 0;
-uint8_t lfo_steps = 0;
+
+Journal journal; //undo/redo of edits to either track
+Song song; //arrangement of patches, loaded by the ui as the song moves on
 
 Calibration *calibrationVar;
 Dac *dacVar;
 
 static const int ROLL_PAUSE_DURATION = 5;
+
+//sequence settings as the active step plays them, with its parameter locks applied
+static inline uint8_t lockedValue(track& t, uint8_t param, uint8_t value){
+	return (t.lock.mask & (1 << param)) ? t.lock.values[param] : value;
+}
+static inline int8_t lockedTranspose(track& t){ return lockedValue(t, LOCK_TRANSPOSE, t.seq->transpose) + song.getTranspose(); }
+static inline uint8_t lockedGlideLength(track& t){ return lockedValue(t, LOCK_GLIDE, t.seq->glide_length); }
+static inline uint8_t lockedEffect(track& t){ return lockedValue(t, LOCK_EFFECT, t.seq->effect); }
+static inline uint8_t lockedEffectDepth(track& t){ return lockedValue(t, LOCK_EFFECT_DEPTH, t.seq->effect_depth); }
+static inline uint8_t lockedSwing(){ return lockedValue(tracks[0], LOCK_SWING, tracks[0].seq->swing); }
 const int CLOCK_PULSE_DURATION = 10; //milliseconds pulse width of clock output
 elapsedMillis timekeeper;
 unsigned int stepkeeper;
@@ -89,11 +100,19 @@ void Sequencer::init(Calibration& calibration, Dac& dac) {
 	calibrationVar = &calibration;
 
 	dacVar = &dac;
-	for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
-		active_sequence.duration_matrix[i] = 80;
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		tracks[t].output = t;
+		tracks[t].seq = &sequence_banks[t][0];
+		for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+			tracks[t].seq->steps[i].duration = 80;
+		}
+		tracks[t].seq->steps[0].gate = true;
+		tracks[t].seq->scale = 0;
+		tracks[t].prev_sequence_length = tracks[t].seq->sequence_length;
+		pinMode(track_gate_pins[t], OUTPUT);
 	}
+	tracks[1].seq->clock_division = 0; //second track stays off until given a division, leaving DAC channel 1 to CV2
 
-	pinMode(GATE_PIN, OUTPUT);
 	pinMode(CLOCK_OUT_PIN, OUTPUT);
 	pinMode(CLOCK_IN_PIN, INPUT_PULLUP);
 	pinMode(RESET_PIN, INPUT_PULLUP);
@@ -101,19 +120,32 @@ void Sequencer::init(Calibration& calibration, Dac& dac) {
 	attachInterrupt(digitalPinToInterrupt(CLOCK_IN_PIN), onClockIn, FALLING);
 	// attachInterrupt(digitalPinToInterrupt(RESET_PIN), onResetIn, FALLING);
 
-    active_sequence.scale = 0;
-	prev_sequence_length = active_sequence.sequence_length;
-	incrementScale(0);
+	rebuildPitchPool();
 	incrementTempo(0);
-	updateGlideCalc();
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		loadScale(tracks[t]);
+		updateGlideCalc(tracks[t]);
+	}
+	restartRandom();
 	mutate_on_reset = calibrationVar->readMutateOnReset();
+	switch_quantize = calibrationVar->readSwitchQuantize();
+	if (switch_quantize >= SWITCH_MODES) switch_quantize = SWITCH_PATTERN; //never set, EEPROM still erased
+	for (byte r = 0; r < MOD_ROUTES; r++) {
+		mod_route &route = mod_routes[r];
+		route.source = calibrationVar->readModRoute(r, 0);
+		route.destination = calibrationVar->readModRoute(r, 1);
+		route.amount = calibrationVar->readModRoute(r, 2);
+		if (route.source > MOD_INPUTS || route.destination >= MOD_DESTINATIONS || abs(route.amount) > MOD_MAX_AMOUNT) {
+			route = mod_route(); //never set
+		}
+	}
 }
 
 void Sequencer::updateClock() {
 
 	if (play_active || count_next_swing_step) {
-		if (timekeeper > (clock_step % 2 == 1 ? tempo_millis_swing_even : tempo_millis_swing_odd)) {
-			
+		if (timekeeper > (clock_tick == 1 ? tempo_millis_swing_even : tempo_millis_swing_odd)) {
+
 			if (play_active) {
 				incrementStep();
 				if (auditioning) {
@@ -132,10 +164,17 @@ void Sequencer::updateClock() {
 			step_incremented = false;
 		}
 	}
-	
-	updateGlide();
-	updateGate();
 
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		if (!trackEnabled(tracks[t])) continue;
+		updateGlide(tracks[t]);
+		updateGate(tracks[t]);
+	}
+
+	if (clock_out_active && timekeeper > CLOCK_PULSE_DURATION) {
+		digitalWrite(CLOCK_OUT_PIN, LOW);
+		clock_out_active = false;
+	}
 
 
 	//4 possible states
@@ -148,7 +187,7 @@ void Sequencer::updateClock() {
 		if (mutate_on_reset) {
 			onMutate(true);
 		} else {
-			onReset(); 
+			onReset();
 		}
 		reset_in_active = true;
 	} else if (reset_in_active == true && ((PIND & _BV(4)) >> 4) == HIGH) {
@@ -180,308 +219,460 @@ void Sequencer::onClock(){
 		return;
 	}
 
-	if ((active_sequence.swing > 50) && (clock_step % 2 == 0)) { //ignore external clock to implement swing
+	if ((lockedSwing() > 50) && (clock_tick == 0)) { //ignore external clock to implement swing
 	 	skip_next_external_step = true;
 		count_next_swing_step = true; //these two states *should* stay in sync but in practice microtiming requires two vars for values near 50
-	} 
+	}
+
 
-	
 	calculated_tempo = timekeeper;
 	updateSwingCalc();
 	incrementStep();
 	timekeeper = 0;
-		
+
 	play_active = false;
 }
 
 
 void Sequencer::onReset(){
-	clock_step =  -1; //clock_active ? -1 : 0;
-	current_step = clock_step;
+	clock_tick = -1;
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		tracks[t].clock_step = -1; //clock_active ? -1 : 0;
+		tracks[t].current_step = -1;
+		tracks[t].division_counter = 0;
+		memset(tracks[t].lane_step, -1, sizeof(tracks[t].lane_step));
+		tracks[t].loop_count = 0;
+		tracks[t].first_loop = true;
+	}
 	step_incremented = false;
 	first_step = true;
 	song_mode_loops = 0;
+	phrase_bar = 3;
+	restartRandom();
 	if (clock_in_active == false && digitalRead(CLOCK_IN_PIN) == LOW) { //enable slight delay on reset signal
 		onClockIn();
 	}
 }
 
-void Sequencer::incrementStep() {
-	clock_step++;
-	if (clock_step >= active_sequence.sequence_length) {
-		clock_step = 0;
-		if (song_mode) {
-			song_mode_loops += 1;
-			if (song_mode_loops >= active_sequence.song_loops) {
-				time_for_next_sequence = true;
-			}	
-		}
-	}
+void Sequencer::incrementStep() { //one tick of the base clock, each track steps on its own division
+	clock_tick = clock_tick == 0 ? 1 : 0;
 
 	if (!clock_out_active) {
 		clock_out_active = true;
 		digitalWrite(CLOCK_OUT_PIN, HIGH);
-	} 
-
-	runStepEffects();
+	}
 
-	if (active_sequence.step_matrix[current_step]) {
-		active_step = current_step;
-		prev_note = active_note;
-		prev_note2 = active_note2;
-		setLfoTarget();
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		tracks[t].step_advanced = false;
+		if (trackEnabled(tracks[t])) {
+			advanceTrack(tracks[t]);
+		}
 	}
 
 	step_incremented = true;
 }
 
-void Sequencer::runStepEffects(){
-	if (seq_recording_effect) { //while recording, respect mutate button state and record active/inactive to current step
-		active_sequence.effect_matrix[current_step] = mutate_button;
-	} else if (active_sequence.effect_matrix[current_step]) { //if mutation data is recorded, play it back
-		if (!seq_effect_mode) setEffectMode(true); //don't re-trigger effect mode, to avoid messing up timings set by prev steps
-	} else if (seq_effect_mode && !mutate_button && !(mutate_on_reset && reset_in_active)) {
-		setEffectMode(false); //turn off sequenced effect after recorded activity (when not manually engaged) 
+void Sequencer::advanceTrack(track& t) {
+	if (t.clock_step >= 0 && t.division_counter + 1 < t.seq->clock_division) {
+		t.division_counter++;
+		return;
+	}
+	t.division_counter = 0;
+
+	t.clock_step++;
+	if (t.clock_step >= t.seq->sequence_length) {
+		t.clock_step = 0;
+		t.first_loop = false;
+		if (++t.loop_count >= TRIG_LOOP_CYCLE) {
+			t.loop_count = 0;
+		}
+		if (song.isPlaying() && &t == &tracks[0]) { //song position follows the first track
+			song_mode_loops += 1;
+			if (song_mode_loops >= song.entry(song.getPosition()).repeats) {
+				song_mode_loops = 0; //the next entry counts from here, even if its patch can't be loaded
+				time_for_next_sequence = true;
+				switch_aligned = true;
+			}
+		}
+	}
+	if (&t == &tracks[0]) {
+		if (t.clock_step % 16 == 0) phrase_bar = (phrase_bar + 1) & 3;
+		if (switch_queued && onSwitchBoundary(t)) {
+			switch_queued = false;
+			time_for_next_sequence = true;
+			switch_aligned = true;
+		}
+	}
+
+	runStepEffects(t);
+	advanceLanes(t);
+	t.arp_note = arp_key_count && &t == &editTrack() ? nextArpNote(t) : -1;
+	decideStep(t);
+
+	t.step_advanced = true;
+}
+
+void Sequencer::decideStep(track& t){ //whether the current step plays, and latch it if so
+	t.step_fires = stepFires(t);
+
+	if (t.step_fires) {
+		latchActiveStep(t, t.current_step);
+		t.prev_note = t.active_note;
+		t.prev_note2 = t.active_note2;
+		setLfoTarget(t);
+	}
+}
+
+void Sequencer::runStepEffects(track& t){
+	sequence &seq = *t.seq;
+	if (seq_recording_effect && &t == &editTrack()) { //while recording, respect mutate button state and record active/inactive to current step
+		seq.steps[t.current_step].effect = mutate_button;
+	} else if (seq.steps[t.current_step].effect) { //if mutation data is recorded, play it back
+		if (!t.effect_mode) setEffectMode(t, true); //don't re-trigger effect mode, to avoid messing up timings set by prev steps
+	} else if (t.effect_mode && !mutate_button && !(mutate_on_reset && reset_in_active)) {
+		setEffectMode(t, false); //turn off sequenced effect after recorded activity (when not manually engaged)
 	}
-	
+
 
 	//prev_step = current_step;
 
-	if (seq_effect_mode && active_sequence.effect == EFFECT_REPEAT) {
+	if (t.effect_mode && lockedEffect(t) == EFFECT_REPEAT) {
 		//repeat_step_counter++;
-		if (current_step == repeat_step_origin){
-			current_step = current_step - active_sequence.effect_depth + 1;
-			if (current_step < 0) {
-				current_step = active_sequence.sequence_length + current_step;
+		if (t.current_step == t.repeat_step_origin){
+			t.current_step = t.current_step - lockedEffectDepth(t) + 1;
+			if (t.current_step < 0) {
+				t.current_step = seq.sequence_length + t.current_step;
 			}
 		} else {
-			current_step++;
-			if (current_step == active_sequence.sequence_length) {
-				current_step = 0;
+			t.current_step++;
+			if (t.current_step == seq.sequence_length) {
+				t.current_step = 0;
 			}
 		}
-	} else if (seq_effect_mode && active_sequence.effect == EFFECT_REVERSE) {
-		current_step--;
-		if (current_step < 0) {
-			current_step = active_sequence.sequence_length - 1;
+	} else if (t.effect_mode && lockedEffect(t) == EFFECT_REVERSE) {
+		t.current_step--;
+		if (t.current_step < 0) {
+			t.current_step = seq.sequence_length - 1;
 		}
-	} else if (seq_effect_mode && active_sequence.effect == EFFECT_FREEZE) {
+	} else if (t.effect_mode && lockedEffect(t) == EFFECT_FREEZE) {
 		//don't increment step
 	} else {
-		current_step = clock_step;
+		t.current_step = t.clock_step;
 	}
 
 	// if (step_recording_mode) {
-	// 	active_sequence.step_matrix[current_step] = true;
+	// 	seq.steps[t.current_step].gate = true;
 	// }
+}
+
+bool Sequencer::stepFires(track& t){ //decided at step time, the stored pattern is never rewritten
+	sequence &seq = *t.seq;
+	if (t.arp_note >= 0) return true; //held keys play on every step
+	//in randomize mode, density picks the steps in place of the pattern
+	if (t.effect_mode && t.turing_mode && lockedEffect(t) != EFFECT_TURING1) {
+		return t.random.range(20) <= lockedEffectDepth(t);
+	}
+	if (!seq.steps[t.current_step].gate) return false;
+
+	uint8_t trig = seq.trig_matrix[t.current_step];
+	uint8_t condition = trig >> 4;
+	if (condition == TRIG_FIRST || condition == TRIG_NOT_FIRST) {
+		if (t.first_loop != (condition == TRIG_FIRST)) return false;
+	} else if (condition == TRIG_FILL || condition == TRIG_NOT_FILL) {
+		if (fill_active != (condition == TRIG_FILL)) return false;
+	} else if (condition != TRIG_ALWAYS && condition <= TRIG_4_4) {
+		if (!((pgm_read_word_near(trig_loop_masks + condition - 1) >> t.loop_count) & 1)) return false;
+	}
 
-	//in randomize mode, enable steps with
-	if (seq_effect_mode && turing_mode && (active_sequence.effect == EFFECT_TURING2 || active_sequence.effect == EFFECT_TURING3)) {
-		bool step_active =  (rand() % 20) <= active_sequence.effect_depth ? true : false;
-		active_sequence.step_matrix[current_step] = step_active;
+	uint8_t probability = trig & 0x0F;
+	return !probability || t.random.chance((16 - probability) << 4);
+}
+
+void Sequencer::advanceLanes(track& t){ //lanes with their own length step with the clock, wrapping on their own
+	if (t.effect_mode && lockedEffect(t) == EFFECT_FREEZE) return;
+	int8_t direction = (t.effect_mode && lockedEffect(t) == EFFECT_REVERSE) ? -1 : 1;
+	for (byte l = 0; l < LANE_COUNT; l++) {
+		uint8_t length = t.seq->lane_length[l];
+		if (!length) continue;
+		int16_t &lane_step = t.lane_step[l];
+		lane_step += direction;
+		if (lane_step >= length) {
+			lane_step = 0;
+		} else if (lane_step < 0) {
+			lane_step = length - 1;
+		}
 	}
 }
 
-void Sequencer::setLfoTarget(){
+void Sequencer::latchActiveStep(track& t, uint8_t step){ //lanes following the gate lane read the same step
+	t.active_step = step;
+	for (byte l = 0; l < LANE_COUNT; l++) {
+		t.active_lane_step[l] = t.seq->lane_length[l] ? max(t.lane_step[l], 0) : step;
+	}
+	t.motion_substep = MOTION_SUBSTEPS; //no sample of the new step played yet
+	resolveLocks(t);
+}
+
+void Sequencer::setLfoTarget(track& t){
+	sequence &seq = *t.seq;
 	//SET VALUE FOR NEXT LFO STEP
-	if (active_sequence.cv_mode == 1) {
-		lfo_prev = lfo_target;
-		lfo_target = -1;
+	if (seq.cv_mode == 1 && hasCv2(t)) {
+		t.lfo_prev = t.lfo_target;
+		t.lfo_target = -1;
 
 		//find next active step and get lfo value
-		uint8_t i = active_step + 1;
-		while (i < active_sequence.sequence_length) {
-			if (active_sequence.step_matrix[i]) {
-				lfo_target = active_sequence.cv_matrix[i];
-				lfo_steps = i - active_step;
+		uint8_t i = t.active_step + 1;
+		while (i < seq.sequence_length) {
+			if (seq.steps[i].gate) {
+				t.lfo_target = seq.steps[i].cv;
+				t.lfo_steps = i - t.active_step;
 				break;
 			}
 			i++;
 		}
-		if (lfo_target == -1) {
+		if (t.lfo_target == -1) {
 			i = 0;
-			while (i < current_step) {
-				if (active_sequence.step_matrix[i]) {
-					lfo_target = active_sequence.cv_matrix[i];
-					lfo_steps = i + active_sequence.sequence_length - active_step;
+			while (i < t.current_step) {
+				if (seq.steps[i].gate) {
+					t.lfo_target = seq.steps[i].cv;
+					t.lfo_steps = i + seq.sequence_length - t.active_step;
 					break;
 				}
 				i++;
-			}	
+			}
+		}
+		if (t.lfo_target == -1) {
+			t.lfo_target = seq.steps[t.active_step].cv;
+			t.lfo_steps = 1;
 		}
-		if (lfo_target == -1) {
-			lfo_target = active_sequence.cv_matrix[active_step];
-			lfo_steps = 1;
+		if (seq.lane_length[LANE_CV]) { //own cv lane: glide to where that lane will be at the next note
+			uint8_t cv_step = t.active_lane_step[LANE_CV] + t.lfo_steps;
+			while (cv_step >= seq.lane_length[LANE_CV]) {
+				cv_step -= seq.lane_length[LANE_CV];
+			}
+			t.lfo_target = seq.steps[cv_step].cv;
 		}
-		lfo_time = lfo_steps * calculated_tempo;
+		t.lfo_time = t.lfo_steps * getStepLength(t);
 	}
 }
 
 void Sequencer::setActiveNote(){
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		if (tracks[t].step_advanced) {
+			setActiveNote(tracks[t]);
+		}
+	}
+}
+
+void Sequencer::setActiveNote(track& t){
+	sequence &seq = *t.seq;
 	//PITCH/OCTAVE/GATE for current step
-	if (active_sequence.step_matrix[current_step]) {
-		if (seq_effect_mode && active_sequence.effect == EFFECT_STOP) {
-			updateGlide(); 
-			if (!note_reached) { //stop gate after glide reaches zero
-				digitalWrite(GATE_PIN, active_sequence.step_matrix[active_step] ? HIGH : LOW);
-				gate_active = active_sequence.step_matrix[active_step];
+	if (t.step_fires) {
+		if (t.effect_mode && lockedEffect(t) == EFFECT_STOP) {
+			updateGlide(t);
+			if (!t.note_reached) { //stop gate after glide reaches zero
+				setGate(t, seq.steps[t.active_step].gate || t.arp_note >= 0);
 			}
 		} else {
-			note_reached = false;
-			setPitchOutput(active_step);
+			t.note_reached = false;
+			setPitchOutput(t, t.active_step, t.active_lane_step);
 
-			digitalWrite(GATE_PIN, active_sequence.step_matrix[active_step] ? HIGH : LOW);
-			gate_active = active_sequence.step_matrix[active_step];
+			setGate(t, seq.steps[t.active_step].gate || t.arp_note >= 0);
 
-			calculated_step_length = (active_sequence.duration_matrix[active_step] / 100.0) * (double)calculated_tempo;
+			t.calculated_step_length = (seq.steps[t.active_lane_step[LANE_DURATION]].duration / 100.0) * (double)getStepLength(t);
 		}
-	} else if(seq_effect_mode && active_sequence.effect == EFFECT_STUTTER) {
-		digitalWrite(GATE_PIN, HIGH);
-		gate_active = true;
+	} else if(t.effect_mode && lockedEffect(t) == EFFECT_STUTTER) {
+		setGate(t, true);
 	}
 }
 
-void Sequencer::setPitchOutput(uint8_t step){
-	if (seq_effect_mode && turing_mode) {
-		generateTuringPitches();
+void Sequencer::setGate(track& t, bool state){
+	digitalWrite(track_gate_pins[t.output], state ? HIGH : LOW);
+	t.gate_active = state;
+}
+
+void Sequencer::setPitchOutput(track& t, uint8_t step, uint8_t *lanes){ //step is on the gate lane, lanes holds the position in each lane
+	sequence &seq = *t.seq;
+	if (t.effect_mode && t.turing_mode) {
+		generateTuringPitches(t);
+	}
+	uint8_t pitch_step = lanes[LANE_PITCH];
+	if (t.arp_note >= 0) { //held keys stand in for the pitch lane, from the root of octave 0
+		t.active_note = 3 * 12 + t.arp_note;
+	} else {
+		t.active_note = quantizePitch(t, seq.steps[pitch_step].pitch); // + 24;
+		t.active_note = ((seq.steps[pitch_step].octave + 3) * 12) + t.active_note;
 	}
-	active_note = quantizePitch(active_sequence.pitch_matrix[step]); // + 24;
-	active_note = ((active_sequence.octave_matrix[step] + 3) * 12) + 
-	 				active_note + 
-	 				(active_sequence.transpose - 24)  + 
-	 				(random_octave * 12);
+	t.active_note += (lockedTranspose(t) - 24)  +
+	 				(t.random_octave * 12);
 
-	if (seq_effect_mode && active_sequence.effect == EFFECT_OCTAVE) {
-		active_note += (active_sequence.effect_depth - 4) * 12;
+	if (t.effect_mode && lockedEffect(t) == EFFECT_OCTAVE) {
+		t.active_note += (lockedEffectDepth(t) - 4) * 12;
 	}
 
-	if (active_sequence.glide_matrix[step] && !auditioning) {
-		updateGlide();
+	if (seq.steps[step].glide && !auditioning) {
+		updateGlide(t);
 	} else {
-		current_note_value = calibrationVar->getCalibratedOutput(active_note, 0);
-		dacVar->setOutput(0, GAIN_2, 1, current_note_value);
+		t.current_note_value = calibrationVar->getCalibratedOutput(t.active_note, t.output);
+		dacVar->setOutput(t.output, GAIN_2, 1, t.current_note_value);
 	}
 
-	setCv2Output(step);	
+	if (hasCv2(t)) {
+		setCv2Output(t, lanes);
+	}
 }
 
-void Sequencer::setCv2Output(uint8_t step){
-	if (seq_effect_mode && (active_sequence.effect == EFFECT_CHORD || active_sequence.effect == EFFECT_CHORD_Q || active_sequence.effect == EFFECT_SUB)) {
-			if (active_sequence.effect == EFFECT_CHORD_Q) {
-				active_note2 = quantizePitch(active_sequence.pitch_matrix[step] + active_sequence.effect_depth - 12) + 24;
-				active_note2 = active_note2 + ((active_sequence.octave_matrix[step] + 3) * 12) + (active_sequence.transpose - 24) + (random_octave * 12);
-			} else if ( active_sequence.effect == EFFECT_CHORD) {
-				active_note2 = active_note + active_sequence.effect_depth - 12;
+void Sequencer::setCv2Output(track& t, uint8_t *lanes){
+	sequence &seq = *t.seq;
+	uint8_t pitch_step = lanes[LANE_PITCH];
+	uint8_t cv_step = lanes[LANE_CV];
+	uint8_t effect = lockedEffect(t);
+	if (t.effect_mode && (effect == EFFECT_CHORD || effect == EFFECT_CHORD_Q || effect == EFFECT_SUB)) {
+			if (effect == EFFECT_CHORD_Q) {
+				t.active_note2 = quantizePitch(t, seq.steps[pitch_step].pitch + lockedEffectDepth(t) - 12) + 24;
+				t.active_note2 = t.active_note2 + ((seq.steps[pitch_step].octave + 3) * 12) + (lockedTranspose(t) - 24) + (t.random_octave * 12);
+			} else if ( effect == EFFECT_CHORD) {
+				t.active_note2 = t.active_note + lockedEffectDepth(t) - 12;
 			} else { //sub osc mode - offset by octaves
-				active_note2 = active_note + (active_sequence.effect_depth - 3) * 12;
+				t.active_note2 = t.active_note + (lockedEffectDepth(t) - 3) * 12;
 			}
-			current_note_value2 = calibrationVar->getCalibratedOutput(active_note2, 1);
-			dacVar->setOutput(1, GAIN_2, 1, current_note_value2);
+			t.current_note_value2 = calibrationVar->getCalibratedOutput(t.active_note2, 1);
+			dacVar->setOutput(1, GAIN_2, 1, t.current_note_value2);
 			return;
 	}
 
-	switch (active_sequence.cv_mode) {
+	t.motion_substep = 0;
+	int8_t cv = seq.steps[cv_step].cv;
+	if (cv_step < MOTION_STEPS && seq.motion[cv_step].key != MOTION_NONE) cv = seq.motion[cv_step].key;
+	renderCv2(t, cv, pitch_step);
+}
+
+void Sequencer::renderCv2(track& t, int8_t cv, uint8_t pitch_step){ //cv is the cv of a step or a motion sample
+	sequence &seq = *t.seq;
+	if (t.cv2_offset) cv = offsetCv2(t, cv);
+	switch (seq.cv_mode) {
 		case 0://normal linear mode, same as lfo without smoothing
 		case 1://lfo interpolated step mode
-			current_note_value2 =  active_sequence.cv_matrix[step] * 40;
+			t.current_note_value2 =  cv * 40;
 			break;
 		case 2://interval mode - relative to pitch1
-			active_note2 = quantizePitch(active_sequence.pitch_matrix[step] + active_sequence.cv_matrix[step]);
-			active_note2 = ((active_sequence.octave_matrix[step] + 3) * 12) + 
-	 				active_note2 + 
-	 				(active_sequence.transpose - 24)  + 
-	 				(random_octave * 12);
+			t.active_note2 = quantizePitch(t, seq.steps[pitch_step].pitch + cv);
+			t.active_note2 = ((seq.steps[pitch_step].octave + 3) * 12) +
+	 				t.active_note2 +
+	 				(lockedTranspose(t) - 24)  +
+	 				(t.random_octave * 12);
 
-			current_note_value2 = calibrationVar->getCalibratedOutput(active_note2, 1);
+			t.current_note_value2 = calibrationVar->getCalibratedOutput(t.active_note2, 1);
 			break;
 		case 3://note mode - quantized pitch
-			active_note2 = quantizePitch(active_sequence.cv_matrix[step]);
-			active_note2  += (active_sequence.transpose - 24) + (random_octave * 12);
-			current_note_value2 = calibrationVar->getCalibratedOutput(active_note2, 1);
+			t.active_note2 = quantizePitch(t, cv);
+			t.active_note2  += (lockedTranspose(t) - 24) + (t.random_octave * 12);
+			t.current_note_value2 = calibrationVar->getCalibratedOutput(t.active_note2, 1);
 			break;
 	}
-	dacVar->setOutput(1, GAIN_2, 1, current_note_value2);
+	dacVar->setOutput(1, GAIN_2, 1, t.current_note_value2);
 
 }
 
 void Sequencer::auditionNote(bool gate, int timer){ //used only for audition
-	setPitchOutput(selected_step);
-	digitalWrite(GATE_PIN, gate ? HIGH : LOW);
-	gate_active = gate;
+	track &t = editTrack();
+	uint8_t lanes[LANE_COUNT];
+	memset(lanes, selected_step, sizeof(lanes)); //the selected step on every lane
+	setPitchOutput(t, selected_step, lanes);
+	setGate(t, gate);
 	auditioning = gate;
 	audition_step_length = timekeeper + timer;
 }
 
 
-int8_t Sequencer::quantizePitch(int8_t pitch_to_quantize){
+int8_t Sequencer::randomSign(track& t){
+	return t.random.range(10) > 5 ? -1 : 1;
+}
+
+int8_t Sequencer::quantizePitch(track& t, int8_t pitch_to_quantize){
 	int8_t pitch = pitch_to_quantize;
-	random_octave = 0;
-	if (seq_effect_mode && active_sequence.effect == EFFECT_RANDOM) {
-		pitch += (rand() % active_sequence.effect_depth) * (rand() % 10 > 5 ? -1 : 1);
-	} else if (seq_effect_mode && active_sequence.effect == EFFECT_TRANSPOSE) {
-		pitch += active_sequence.effect_depth - 24;
+	t.random_octave = 0;
+	if (t.effect_mode && lockedEffect(t) == EFFECT_RANDOM) {
+		pitch += t.random.range(lockedEffectDepth(t)) * randomSign(t);
+	} else if (t.effect_mode && lockedEffect(t) == EFFECT_TRANSPOSE) {
+		pitch += lockedEffectDepth(t) - 24;
 	}
 
 	//normalize to 2 octaves
 	if (pitch > 12) {
-		if (pitch >= 36) random_octave = 3;
-		else random_octave = pitch >= 24 ? 2 : 1;
+		if (pitch >= 36) t.random_octave = 3;
+		else t.random_octave = pitch >= 24 ? 2 : 1;
 		pitch = pitch % 12;
 	} else if (pitch < -12) {
-		if (pitch <= -36) random_octave = -3;
-		random_octave = pitch <= -24 ? -2 : -1;
+		if (pitch <= -36) t.random_octave = -3;
+		t.random_octave = pitch <= -24 ? -2 : -1;
 		pitch = pitch % -12;
 	}
 
 	//quantize to scale
-	if (current_scale_tones[pitch >= 0 ? pitch : pitch + 12] == false) {
-		if (active_sequence.scale == 3) { //major pentatonic
-			pitch += quantize_pen[pitch >= 0 ? pitch : pitch + 12];
-		} else if (active_sequence.scale == 4) { //minor pentatonic
-			pitch += quantize_pem[pitch >= 0 ? pitch : pitch + 12];
-		} else {//all others (diatonics)
-			pitch += quantize_map[pitch >= 0 ? pitch : pitch + 12];
-		}
+	if (!scaleHasTone(t, pitch)) {
+		pitch += scaleCorrection(t, pitch >= 0 ? pitch : pitch + 12);
 	}
 
 	return pitch;
 }
 
-void Sequencer::generateTuringPitches(){
-	if (active_sequence.effect == EFFECT_TURING1) {
+int8_t Sequencer::scaleCorrection(track& t, uint8_t pitch_class){ //semitones to the nearest scale degree
+	if (t.seq->scale == 3) { //major pentatonic
+		return quantize_pen[pitch_class];
+	} else if (t.seq->scale == 4) { //minor pentatonic
+		return quantize_pem[pitch_class];
+	}
+	return quantize_map[pitch_class]; //all others (diatonics)
+}
+
+void Sequencer::generateTuringPitches(track& t){
+	sequence &seq = *t.seq;
+	int16_t active_step = t.active_step;
+	uint8_t pitch_step = t.active_lane_step[LANE_PITCH];
+	uint8_t duration_step = t.active_lane_step[LANE_DURATION];
+	uint8_t cv_step = t.active_lane_step[LANE_CV];
+	int8_t pitch = seq.steps[pitch_step].pitch; //worked on outside the 5-bit field, which only holds -16..15
+	if (lockedEffect(t) == EFFECT_TURING1) {
 			//turing 1 uses depth as "randomness"
-		active_sequence.pitch_matrix[active_step] += (rand() % active_sequence.effect_depth) * (rand() % 10 > 5 ? -1 : 1);
-	} else if (active_sequence.effect == EFFECT_TURING2) {
+		pitch += t.random.range(lockedEffectDepth(t)) * randomSign(t);
+	} else if (lockedEffect(t) == EFFECT_TURING2) {
 		//turing 2 rearranges sequence using existing  pitches, and uses depth as "density"
-		int random_pitch = rand() % num_active_pitches;
-		active_sequence.pitch_matrix[active_step] = active_pitches[random_pitch];
-		active_sequence.duration_matrix[active_step] = (rand() % 130) + 20; //20-170
-	} else if (active_sequence.effect == EFFECT_TURING3) {
+		if (t.num_active_pitches > 0) {
+			pitch = t.active_pitches[t.random.range(t.num_active_pitches)];
+		}
+		seq.steps[duration_step].duration = t.random.range(130) + 20; //20-170
+	} else if (lockedEffect(t) == EFFECT_TURING3) {
 		//turing 3 is fixed at +/-2 octaves and uses depth as "density" for rhythm
 		//also randomizes duration, cv and glide on/off
-		active_sequence.pitch_matrix[active_step] = (rand() % 24) * (rand() % 10 > 5 ? -1 : 1); //-24/+24
-		active_sequence.glide_matrix[active_step] =  (rand() % 10) >= 9 ? true : false; //glide 10% on
-		active_sequence.duration_matrix[active_step] = (rand() % 130) + 20; //20-170
-		if (active_sequence.cv_mode == 2) { // interval
-			active_sequence.cv_matrix[active_step] = rand() % 24 - 12; //-24-24;
-		} else if (active_sequence.cv_mode == 3) { //note
-			active_sequence.cv_matrix[active_step] = rand() % 48 + 12; //12-60;
+		pitch = t.random.range(24) * randomSign(t); //-24/+24
+		seq.steps[active_step].glide = t.random.range(10) >= 9; //glide 10% on
+		seq.steps[duration_step].duration = t.random.range(130) + 20; //20-170
+		if (seq.cv_mode == 2) { // interval
+			seq.steps[cv_step].cv = t.random.range(24) - 12; //-24-24;
+		} else if (seq.cv_mode == 3) { //note
+			seq.steps[cv_step].cv = t.random.range(48) + 12; //12-60;
 		} else {
-			active_sequence.cv_matrix[active_step] = rand() % 90; //0-90;
+			seq.steps[cv_step].cv = t.random.range(90); //0-90;
 		}
 	}
 
-	if (abs(active_sequence.pitch_matrix[active_step]) > 12) { 
-		int octave_adjust = active_sequence.pitch_matrix[active_step] > 0 ? 1 : -1;
-		active_sequence.octave_matrix[active_step] += octave_adjust;
-		active_sequence.octave_matrix[active_step] = max(min(active_sequence.octave_matrix[active_step], 2), -2);
-		active_sequence.pitch_matrix[active_step] = (active_sequence.pitch_matrix[active_step] % 12) * octave_adjust;
+	int8_t octave = seq.steps[pitch_step].octave;
+	while (pitch > 12) { //fold into +/-12, carrying whole octaves
+		pitch -= 12;
+		octave++;
+	}
+	while (pitch < -12) {
+		pitch += 12;
+		octave--;
 	}
-	//return active_sequence.pitch_matrix[active_step];
+	seq.steps[pitch_step].pitch = pitch;
+	seq.steps[pitch_step].octave = max(min(octave, 2), -2);
+	//return seq.steps[pitch_step].pitch;
 }
 
 int Sequencer::getCurrentStep(){
-	return current_step;
+	return editTrack().current_step;
 }
 
 bool Sequencer::stepWasIncremented(){
@@ -489,117 +680,157 @@ bool Sequencer::stepWasIncremented(){
 }
 
 
-void Sequencer::updateGlide() {
-	if (seq_effect_mode && active_sequence.effect == EFFECT_STOP) {
-		if (note_reached) return;
-		double glidekeeper = getGlideKeeper(repeat_step_origin);
-		double stopTime = active_sequence.effect_depth * calculated_tempo;
+void Sequencer::updateGlide(track& t) {
+	sequence &seq = *t.seq;
+	if (t.effect_mode && lockedEffect(t) == EFFECT_STOP) {
+		if (t.note_reached) return;
+		double glidekeeper = getGlideKeeper(t, t.repeat_step_origin);
+		double stopTime = lockedEffectDepth(t) * getStepLength(t);
 
-		double instantaneous_pitch = active_note * (stopTime - glidekeeper) / stopTime;
-		note_reached = (instantaneous_pitch < 1);
-		current_note_value = calibrationVar->getCalibratedOutput(instantaneous_pitch, 0);
-		dacVar->setOutput(0, GAIN_2, 1, current_note_value);
-		if (note_reached) {
-			digitalWrite(GATE_PIN, LOW);
-			gate_active = false;
+		double instantaneous_pitch = t.active_note * (stopTime - glidekeeper) / stopTime;
+		t.note_reached = (instantaneous_pitch < 1);
+		t.current_note_value = calibrationVar->getCalibratedOutput(instantaneous_pitch, t.output);
+		dacVar->setOutput(t.output, GAIN_2, 1, t.current_note_value);
+		if (t.note_reached) {
+			setGate(t, false);
 			auditioning = false;
 		}
-	} else if (seq_effect_mode && active_sequence.effect == EFFECT_VIBRATO) {
-		int vibe_note_value = sin(getGlideKeeper(active_step) / 20.0) * 2.0 * active_sequence.effect_depth; 
-		dacVar->setOutput(0, GAIN_2, 1, vibe_note_value+current_note_value);
-		if (active_sequence.cv_mode == 3 || active_sequence.cv_mode == 2) {
-			dacVar->setOutput(1, GAIN_2, 1, vibe_note_value+current_note_value2);
+	} else if (t.effect_mode && lockedEffect(t) == EFFECT_VIBRATO) {
+		int vibe_note_value = sin(getGlideKeeper(t, t.active_step) / 20.0) * 2.0 * lockedEffectDepth(t);
+		dacVar->setOutput(t.output, GAIN_2, 1, vibe_note_value+t.current_note_value);
+		if (hasCv2(t) && (seq.cv_mode == 3 || seq.cv_mode == 2)) {
+			dacVar->setOutput(1, GAIN_2, 1, vibe_note_value+t.current_note_value2);
 		}
 
-	} else if ((active_sequence.step_matrix[active_step] && active_sequence.glide_matrix[active_step]) || (seq_effect_mode && active_sequence.effect == EFFECT_GLIDE)) {
-		int glidekeeper = getGlideKeeper(active_step);
-		if (glidekeeper < glide_time) {
-			//if (!note_reached) {
-				note_reached = false;
-				double instantaneous_pitch = ((active_note * glidekeeper) + prev_note * (glide_time - glidekeeper)) / double(glide_time);
-				current_note_value = calibrationVar->getCalibratedOutput(instantaneous_pitch, 0);
-				dacVar->setOutput(0, GAIN_2, 1, current_note_value);
-
-				if (active_sequence.cv_mode == 2 || active_sequence.cv_mode == 3) {
-					instantaneous_pitch = ((active_note2 * glidekeeper) + prev_note2 * (glide_time - glidekeeper)) / double(glide_time);
-					current_note_value2 = calibrationVar->getCalibratedOutput(instantaneous_pitch, 0);
-					dacVar->setOutput(1, GAIN_2, 1, current_note_value2);
+	} else if ((seq.steps[t.active_step].gate && seq.steps[t.active_step].glide) || (t.effect_mode && lockedEffect(t) == EFFECT_GLIDE)) {
+		int glidekeeper = getGlideKeeper(t, t.active_step);
+		if (glidekeeper < t.glide_time) {
+			//if (!t.note_reached) {
+				t.note_reached = false;
+				double instantaneous_pitch = ((t.active_note * glidekeeper) + t.prev_note * (t.glide_time - glidekeeper)) / double(t.glide_time);
+				t.current_note_value = calibrationVar->getCalibratedOutput(instantaneous_pitch, t.output);
+				dacVar->setOutput(t.output, GAIN_2, 1, t.current_note_value);
+
+				if (hasCv2(t) && (seq.cv_mode == 2 || seq.cv_mode == 3)) {
+					instantaneous_pitch = ((t.active_note2 * glidekeeper) + t.prev_note2 * (t.glide_time - glidekeeper)) / double(t.glide_time);
+					t.current_note_value2 = calibrationVar->getCalibratedOutput(instantaneous_pitch, 0);
+					dacVar->setOutput(1, GAIN_2, 1, t.current_note_value2);
 				}
 			// }
-		} else if (!note_reached) {
-			current_note_value = calibrationVar->getCalibratedOutput(active_note, 0);
-			dacVar->setOutput(0, GAIN_2, 1, current_note_value);
-			if (active_sequence.cv_mode == 2 || active_sequence.cv_mode == 3) {
-				current_note_value2 = calibrationVar->getCalibratedOutput(active_note2, 0);
-				dacVar->setOutput(1, GAIN_2, 1, current_note_value2);	
+		} else if (!t.note_reached) {
+			t.current_note_value = calibrationVar->getCalibratedOutput(t.active_note, t.output);
+			dacVar->setOutput(t.output, GAIN_2, 1, t.current_note_value);
+			if (hasCv2(t) && (seq.cv_mode == 2 || seq.cv_mode == 3)) {
+				t.current_note_value2 = calibrationVar->getCalibratedOutput(t.active_note2, 0);
+				dacVar->setOutput(1, GAIN_2, 1, t.current_note_value2);
 			}
-			note_reached = true;
+			t.note_reached = true;
 		}
-	} 
+	}
+
+	updateLfo(t);
+	updateMotion(t);
+}
+
+void Sequencer::updateMotion(track& t){ //plays and records the motion lane between steps, a step without motion costs one compare
+	if (!hasCv2(t) || t.active_step < 0 || t.active_lane_step[LANE_CV] >= MOTION_STEPS) return;
+	motion_step &motion = t.seq->motion[t.active_lane_step[LANE_CV]];
+	bool recording = motion_recording && &t == &editTrack();
+	if (!recording && motion.key == MOTION_NONE) return;
+	uint8_t effect = lockedEffect(t);
+	if (t.effect_mode && (effect == EFFECT_CHORD || effect == EFFECT_CHORD_Q || effect == EFFECT_SUB)) return; //cv2 plays the chord
+
+	long substep = (long)getGlideKeeper(t, t.active_step) * MOTION_SUBSTEPS / max(getStepLength(t), 1);
+	if (substep >= MOTION_SUBSTEPS) substep = MOTION_SUBSTEPS - 1;
+	if (substep == t.motion_substep && motion.key != MOTION_NONE) return;
+	t.motion_substep = substep;
+	if (recording) {
+		writeMotion(motion, substep, motion_input);
+	}
+	renderCv2(t, motionSample(motion, substep), t.active_lane_step[LANE_PITCH]);
+}
+
+int8_t Sequencer::motionSample(motion_step& motion, uint8_t substep){ //sum of the deltas up to the sample
+	int8_t value = motion.key;
+	for (byte i = 0; i < substep; i++) {
+		int8_t delta = (motion.deltas[i >> 1] >> ((i & 1) * 4)) & 0x0F;
+		if (delta & 0x08) delta -= 16;
+		value += delta;
+	}
+	return value;
+}
+
+void Sequencer::writeMotion(motion_step& motion, uint8_t substep, int8_t value){
+	if (!substep || motion.key == MOTION_NONE) { //a step starts from an absolute sample, so errors never carry over
+		motion.key = value;
+		memset(motion.deltas, 0, sizeof(motion.deltas));
+		if (!substep) return;
+	}
+	int delta = value - motionSample(motion, substep - 1); //knob moves faster than 7 per sample are slewed
+	delta = constrain(delta, -8, 7);
+	uint8_t shift = ((substep - 1) & 1) * 4;
+	uint8_t &packed = motion.deltas[(substep - 1) >> 1];
+	packed = (packed & ~(0x0F << shift)) | ((delta & 0x0F) << shift);
+}
 
-	updateLfo();
+void Sequencer::setMotionInput(int newVal){ //cv2 knob while recording, sampled by updateMotion from then on
+	motion_input = newVal;
+	motion_recording = seq_record_mode;
 }
 
-void Sequencer:: updateLfo(){
-	if (active_sequence.cv_mode == 1) { // LFO
+void Sequencer:: updateLfo(track& t){
+	uint8_t cv_step = t.active_lane_step[LANE_CV];
+	if (t.seq->cv_mode == 1 && hasCv2(t) && (cv_step >= MOTION_STEPS || t.seq->motion[cv_step].key == MOTION_NONE)) { // LFO, unless recorded motion plays
 		//if (seq_record_mode) return;
-		//linear interpolate using active step value, lfo_target, lfo_steps, 
-		int glidekeeper = getGlideKeeper(active_step); 
+		//linear interpolate using active step value, lfo_target, lfo_steps,
+		int glidekeeper = getGlideKeeper(t, t.active_step);
 		//instantaneous_pitch = ((active_note2 * glidekeeper) + prev_note2 * (glide_time - glidekeeper)) / double(glide_time);
-		current_lfo_value = ((lfo_target * glidekeeper) + lfo_prev * (lfo_time - glidekeeper)) / lfo_time;
-		// current_lfo_value = active_sequence.cv_matrix[active_step]; 
+		current_lfo_value = ((t.lfo_target * glidekeeper) + t.lfo_prev * (t.lfo_time - glidekeeper)) / t.lfo_time;
+		if (t.cv2_offset) current_lfo_value = constrain(current_lfo_value + t.cv2_offset, 0, 100);
+		// current_lfo_value = t.seq->steps[t.active_step].cv;
 		dacVar->setOutput(1, GAIN_2, 1, current_lfo_value * 40.0);
 	}
 }
 
-int Sequencer::getGlideKeeper(int step){
-	int steps_advanced = current_step - step;
-	if (steps_advanced < 0) {
-		steps_advanced = current_step + active_sequence.sequence_length - step;
-	}
-	return(timekeeper + steps_advanced * calculated_tempo);
+int Sequencer::getStepLength(track& t){ //milliseconds per step of this track
+	return calculated_tempo * t.seq->clock_division;
 }
 
-void Sequencer::updateGate() {
-	if (clock_out_active && timekeeper > CLOCK_PULSE_DURATION) {
-		digitalWrite(CLOCK_OUT_PIN, LOW);
-		clock_out_active = false;
+int Sequencer::getGlideKeeper(track& t, int step){ //milliseconds since the given step started
+	int steps_advanced = t.current_step - step;
+	if (steps_advanced < 0) {
+		steps_advanced = t.current_step + t.seq->sequence_length - step;
 	}
-	
-	if (seq_effect_mode) {
-		if (active_sequence.effect == EFFECT_FREEZE) return;
-		if (note_reached && active_sequence.effect == EFFECT_STOP) return;
-		if (active_sequence.effect == EFFECT_ROLL) {
-			for (byte i = 1; i <= active_sequence.effect_depth; i++) {
-				if (gate_active && timekeeper > (calculated_roll * i) - ROLL_PAUSE_DURATION && timekeeper < (calculated_roll * i)) {
-					digitalWrite(GATE_PIN, LOW);
-					gate_active = false;
-				} else if (!gate_active && timekeeper >= calculated_roll * i) {
-					digitalWrite(GATE_PIN, HIGH);
-					gate_active = true;
+	return(timekeeper + (t.division_counter + steps_advanced * t.seq->clock_division) * calculated_tempo);
+}
+
+void Sequencer::updateGate(track& t) {
+	if (t.effect_mode) {
+		if (lockedEffect(t) == EFFECT_FREEZE) return;
+		if (t.note_reached && lockedEffect(t) == EFFECT_STOP) return;
+		if (lockedEffect(t) == EFFECT_ROLL) {
+			unsigned int stepkeeper = timekeeper + t.division_counter * calculated_tempo;
+			for (byte i = 1; i <= lockedEffectDepth(t); i++) {
+				if (t.gate_active && stepkeeper > (t.calculated_roll * i) - ROLL_PAUSE_DURATION && stepkeeper < (t.calculated_roll * i)) {
+					setGate(t, false);
+				} else if (!t.gate_active && stepkeeper >= t.calculated_roll * i) {
+					setGate(t, true);
 				}
 			}
 			return;
 		}
 	}
-	if (!gate_active) return;
+	if (!t.gate_active) return;
 
 	//double percent_step = timekeeper / (double)calculated_tempo * 100.0;
-	int steps_advanced = current_step - active_step + 1;
-	if (steps_advanced < 1) {
-		steps_advanced = current_step + active_sequence.sequence_length - active_step + 1;
-	}
-
-	if (seq_effect_mode && active_sequence.effect == EFFECT_STUTTER && !active_sequence.step_matrix[current_step]) {
-		//if (active_sequence.effect_depth < percent_step * steps_advanced) {
-		if (timekeeper > calculated_stutter) {
-			digitalWrite(GATE_PIN, LOW);
-			gate_active = false;
+	if (t.effect_mode && lockedEffect(t) == EFFECT_STUTTER && !t.step_fires) {
+		//if (seq.effect_depth < percent_step * steps_advanced) {
+		if (timekeeper + t.division_counter * calculated_tempo > t.calculated_stutter) {
+			setGate(t, false);
 		}
-	//} else if (active_sequence.duration_matrix[active_step] < percent_step * steps_advanced) {
-	} else if ((timekeeper + calculated_tempo * (steps_advanced-1) > calculated_step_length && !auditioning) || (auditioning && audition_step_length < timekeeper)) { /// DEFAULT
-		digitalWrite(GATE_PIN, LOW);
-		gate_active = false;
+	//} else if (seq.steps[t.active_step].duration < percent_step * steps_advanced) {
+	} else if ((getGlideKeeper(t, t.active_step) > (int)t.calculated_step_length && !auditioning) || (auditioning && audition_step_length < timekeeper)) { /// DEFAULT
+		setGate(t, false);
 		auditioning = false;
 	}
 
@@ -608,9 +839,10 @@ void Sequencer::updateGate() {
 
 void Sequencer::onPlayButton(){
 	play_active = !play_active;
-	if (!play_active) { 	
-		digitalWrite(GATE_PIN, LOW);
-		gate_active = false;
+	if (!play_active) {
+		for (byte t = 0; t < TRACK_COUNT; t++) {
+			setGate(tracks[t], false);
+		}
 	}
 	timekeeper = 0;
 	calculated_tempo = tempo_millis;
@@ -639,110 +871,724 @@ int Sequencer::incrementTempo(int amount){
 	if (play_active) {
 		calculated_tempo = tempo_millis;
 	}
-	active_sequence.sequence_tempo = tempo_bpm;
+	tracks[0].seq->sequence_tempo = tempo_bpm; //the first track sets tempo and swing for the whole patch
 	updateSwingCalc();
-	updateRollCalc();
-	updateStutterCalc();
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		updateRollCalc(tracks[t]);
+		updateStutterCalc(tracks[t]);
+	}
 	return tempo_bpm;
 }
 
 void Sequencer::updateSwingCalc(){
-	tempo_millis_swing_odd = calculated_tempo * float(active_sequence.swing) / 50.0;
+	tempo_millis_swing_odd = calculated_tempo * float(lockedSwing()) / 50.0;
 	tempo_millis_swing_even = calculated_tempo * 2 - tempo_millis_swing_odd;
 }
 
 int Sequencer::incrementScale(int amount){
-	active_sequence.scale = getMinMaxParam(active_sequence.scale, amount, 0, 9);
-	loadScale(active_sequence.scale);
-	return active_sequence.scale;
+	track &t = editTrack();
+	editField(t, FIELD_SCALE, 0, getMinMaxParam(t.seq->scale, amount, 0, 9));
+	loadScale(t);
+	return t.seq->scale;
+}
+
+static uint8_t effectDefaultDepth(uint8_t effect, uint8_t depth, uint8_t glide_length){ //useful depth to start a newly picked effect from
+	switch (effect) {
+		case EFFECT_GLIDE: return glide_length; //set useful default rather than zero
+		case EFFECT_TRANSPOSE: return 24;
+		case EFFECT_OCTAVE: return 5;//actually zero with offset
+		case EFFECT_REPEAT: return 4;
+		case EFFECT_STOP: return 8;
+		case EFFECT_STUTTER: return 80;
+		case EFFECT_ROLL: return 2;
+		case EFFECT_TURING1: return 4;
+		case EFFECT_TURING2: return 12;
+		case EFFECT_TURING3: return 12;
+		case EFFECT_CHORD:
+		case EFFECT_CHORD_Q: return 19;
+		case EFFECT_SUB: return 2;
+		case EFFECT_VIBRATO: return 5;
+	}
+	return depth;
 }
 
-int Sequencer::incrementEffect(int amount){
-	uint8_t &effect = active_sequence.effect;
-	setMinMaxParamUnsigned(effect, amount, 0, 16);	
-	turing_mode = false;
-	switch (active_sequence.effect) {
-		case EFFECT_GLIDE: active_sequence.effect_depth = active_sequence.glide_length; break; //set useful default rather than zero 
-		case EFFECT_TRANSPOSE: active_sequence.effect_depth = 24; break;
-		case EFFECT_OCTAVE: active_sequence.effect_depth = 5; break;//actually zero with offset
-		case EFFECT_REPEAT: active_sequence.effect_depth = 4; break;
-		case EFFECT_STOP: active_sequence.effect_depth = 8; break;
-		case EFFECT_STUTTER: active_sequence.effect_depth = 80; break;
-		case EFFECT_ROLL: active_sequence.effect_depth = 2; break;
-		case EFFECT_TURING1: active_sequence.effect_depth = 4; turing_mode = true; break; 
-		case EFFECT_TURING2: active_sequence.effect_depth = 12; turing_mode = true; break; 
-		case EFFECT_TURING3: active_sequence.effect_depth = 12; turing_mode = true; break; 
+static int effectDepthDisplay(uint8_t effect, uint8_t depth){
+	switch(effect) {
+		case EFFECT_OCTAVE:  return depth - 4; //this is displayed as -4/+4 in UI
+		case EFFECT_TRANSPOSE: return depth - 24; //this is displayed as -24/+24 in the ui
+		case EFFECT_GLIDE:   return depth * 4; //multiply to get bigger range
 		case EFFECT_CHORD:
-		case EFFECT_CHORD_Q: active_sequence.effect_depth = 19; break;
-		case EFFECT_SUB: active_sequence.effect_depth = 2; break;
-		case EFFECT_VIBRATO: active_sequence.effect_depth = 5; break;
+		case EFFECT_CHORD_Q: return depth - 12;
+		case EFFECT_SUB: return depth - 3;
 	}
+	return depth;
+}
+
+int Sequencer::incrementEffect(int amount){
+	track &t = editTrack();
+	sequence &seq = *t.seq;
+	uint8_t effect = getMinMaxParam(seq.effect, amount, 0, 16);
+	if (effect == seq.effect) return effect;
+	journal.begin(); //the effect and its default depth undo together
+	setField(t, FIELD_EFFECT_TYPE, 0, effect);
+	setField(t, FIELD_EFFECT_DEPTH, 0, effectDefaultDepth(effect, seq.effect_depth, seq.glide_length));
+	t.turing_mode = effect >= EFFECT_TURING1 && effect <= EFFECT_TURING3;
 	incrementEffectDepth(0);
-	return active_sequence.effect;
+	return seq.effect;
 }
 
 
 int Sequencer::incrementEffectDepth(int amount){
-	uint8_t &depth = active_sequence.effect_depth;
-	switch(active_sequence.effect) {
+	track &t = editTrack();
+	editField(t, FIELD_EFFECT_DEPTH, 0, stepEffectDepth(t.seq->effect, t.seq->effect_depth, amount));
+	updateGlideCalc(t);
+	updateRollCalc(t);
+	updateStutterCalc(t);
+	return effectDepthDisplay(t.seq->effect, t.seq->effect_depth);
+}
+
+uint8_t Sequencer::stepEffectDepth(uint8_t effect, uint8_t depth, int amount){ //depth moved within the range of its effect
+	switch(effect) {
 		case EFFECT_REPEAT:  setMinMaxParamUnsigned(depth, amount, 1, 16); break;
-		case EFFECT_OCTAVE:  setMinMaxParamUnsigned(depth, amount, 0, 8); return active_sequence.effect_depth - 4; break;//this is displayed as -4/+4 in UI
-		case EFFECT_TRANSPOSE:setMinMaxParamUnsigned(depth, amount, 0, 48); return active_sequence.effect_depth - 24; break; //this is displayed as -24/+24 in the ui
-		case EFFECT_GLIDE:   setMinMaxParamUnsigned(depth, amount, 1, 100); updateGlideCalc(); return active_sequence.effect_depth * 4; break; //multiply to get bigger range
+		case EFFECT_OCTAVE:  setMinMaxParamUnsigned(depth, amount, 0, 8); break;
+		case EFFECT_TRANSPOSE:setMinMaxParamUnsigned(depth, amount, 0, 48); break;
+		case EFFECT_GLIDE:   setMinMaxParamUnsigned(depth, amount, 1, 100); break;
 		case EFFECT_REVERSE: setMinMaxParamUnsigned(depth, amount, 0, 1); break;
 		case EFFECT_STOP:    setMinMaxParamUnsigned(depth, amount, 1, 16); break;
 		case EFFECT_FREEZE:  setMinMaxParamUnsigned(depth, amount, 0, 1); break;
 		case EFFECT_RANDOM:  setMinMaxParamUnsigned(depth, amount, 1, 50); break;
-		case EFFECT_STUTTER: setMinMaxParamUnsigned(depth, amount, 1, 100); updateStutterCalc(); break;
-		case EFFECT_ROLL:    setMinMaxParamUnsigned(depth, amount, 1, 8); updateRollCalc(); break;
-		case EFFECT_TURING1: 
+		case EFFECT_STUTTER: setMinMaxParamUnsigned(depth, amount, 1, 100); break;
+		case EFFECT_ROLL:    setMinMaxParamUnsigned(depth, amount, 1, 8); break;
+		case EFFECT_TURING1:
 		case EFFECT_TURING2:
 		case EFFECT_TURING3: setMinMaxParamUnsigned(depth, amount, 1, 20); break;
 		case EFFECT_CHORD:
-		case EFFECT_CHORD_Q: setMinMaxParamUnsigned(depth, amount, 0, 24); return active_sequence.effect_depth - 12; break;
-		case EFFECT_SUB: setMinMaxParamUnsigned(depth, amount, 0, 6); return active_sequence.effect_depth - 3; break;
-		case EFFECT_VIBRATO: setMinMaxParamUnsigned(depth, amount, 0, 30); 
+		case EFFECT_CHORD_Q: setMinMaxParamUnsigned(depth, amount, 0, 24); break;
+		case EFFECT_SUB: setMinMaxParamUnsigned(depth, amount, 0, 6); break;
+		case EFFECT_VIBRATO: setMinMaxParamUnsigned(depth, amount, 0, 30);
 	}
-	return active_sequence.effect_depth;
+	return depth;
 }
 
 int Sequencer::incrementSteps(int amount, bool shift_state){
+	track &t = editTrack();
 	if (shift_state && amount != 0) {
 		byte i = 1;
-		while (active_sequence.sequence_length > step_presets[i] && i < sizeof(step_presets)/sizeof(step_presets[0])-2) { i++; }
-		active_sequence.sequence_length = step_presets[amount > 0 ? i+1 : i-1];
+		while (t.seq->sequence_length > step_presets[i] && i < sizeof(step_presets)/sizeof(step_presets[0])-2) { i++; }
+		editField(t, FIELD_LENGTH, 0, step_presets[amount > 0 ? i+1 : i-1]);
 	} else {
-		active_sequence.sequence_length = getMinMaxParam(active_sequence.sequence_length, amount, 1, SEQUENCE_MAX_LENGTH);
+		editField(t, FIELD_LENGTH, 0, getMinMaxParam(t.seq->sequence_length, amount, 1, SEQUENCE_MAX_LENGTH));
+	}
+	if (t.prev_sequence_length != t.seq->sequence_length) {
+		rebuildPitchPool(t);
 	}
-	return prev_sequence_length = active_sequence.sequence_length;
+	return t.prev_sequence_length = t.seq->sequence_length;
 }
 
 int Sequencer::incrementBars(int amount){
-	return active_sequence.bars = getMinMaxParam(active_sequence.bars, amount, 1, 4);
+	return editTrack().seq->bars = getMinMaxParam(editTrack().seq->bars, amount, 1, SEQUENCE_MAX_LENGTH / 16);
 }
 
 
 int Sequencer::incrementSwing(int amount){
-	active_sequence.swing = getMinMaxParam(active_sequence.swing, amount, 10, 90);
+	editField(tracks[0], FIELD_SWING, 0, getMinMaxParam(tracks[0].seq->swing, amount, 10, 90));
 	incrementTempo(0);
-	return active_sequence.swing;
+	return tracks[0].seq->swing;
 }
 
 int Sequencer::incrementTranspose(int amount){
-	active_sequence.transpose = getMinMaxParam(active_sequence.transpose, amount, 0, 48);
-	return active_sequence.transpose - 24;
+	sequence &seq = *editTrack().seq;
+	editField(editTrack(), FIELD_TRANSPOSE, 0, getMinMaxParam(seq.transpose, amount, 0, 48));
+	return seq.transpose - 24;
 }
 
 int Sequencer::incrementGlide(int amount){
-	active_sequence.glide_length = getMinMaxParam(active_sequence.glide_length, amount, 1, 255);
-	updateGlideCalc();
-	return active_sequence.glide_length;
+	track &t = editTrack();
+	editField(t, FIELD_GLIDE_LENGTH, 0, getMinMaxParam(t.seq->glide_length, amount, 1, 255));
+	updateGlideCalc(t);
+	return t.seq->glide_length;
+}
+
+int Sequencer::incrementDivision(int amount){ //the first track can't be switched off
+	track &t = editTrack();
+	t.seq->clock_division = getMinMaxParam(t.seq->clock_division, amount, edit_track == 0 ? 1 : 0, 8);
+	if (!trackEnabled(t)) {
+		setGate(t, false);
+	}
+	updateGlideCalc(t);
+	updateRollCalc(t);
+	updateStutterCalc(t);
+	return t.seq->clock_division;
+}
+
+int Sequencer::incrementProbability(int amount){ //percent chance of the selected step, in 16ths
+	uint8_t trig = editTrack().seq->trig_matrix[selected_step];
+	uint8_t probability = getMinMaxParam(trig & 0x0F, -amount, 0, 15);
+	editField(editTrack(), FIELD_TRIG, selected_step, (trig & 0xF0) | probability);
+	return (16 - probability) * 100 / 16;
+}
+
+int Sequencer::incrementCondition(int amount){
+	uint8_t trig = editTrack().seq->trig_matrix[selected_step];
+	uint8_t condition = getMinMaxParam(trig >> 4, amount, TRIG_ALWAYS, TRIG_NOT_FILL);
+	editField(editTrack(), FIELD_TRIG, selected_step, (condition << 4) | (trig & 0x0F));
+	return condition;
+}
+
+//transforms work in place on the edited track, lane by lane over each lane's own length.
+//reordering uses three reversals, so nothing bigger than one element is ever copied
+template <typename T> static void reverseSteps(T *steps, uint8_t first, uint8_t last){ //reverses [first, last)
+	while (first + 1 < last) {
+		T step = steps[first];
+		steps[first++] = steps[--last];
+		steps[last] = step;
+	}
+}
+
+template <typename T> static void rotateSteps(T *steps, uint8_t length, int amount){ //positive amounts move steps later
+	while (amount < 0) amount += length;
+	while (amount >= length) amount -= length;
+	if (!amount) return;
+	reverseSteps(steps, 0, length);
+	reverseSteps(steps, 0, amount);
+	reverseSteps(steps, amount, length);
+}
+
+//the same for one field of the packed steps, which can't be addressed through a pointer
+void Sequencer::reverseField(sequence& seq, uint8_t field, uint8_t first, uint8_t last){
+	while (first + 1 < last) {
+		uint16_t value = readField(seq, field, first);
+		writeField(seq, field, first++, readField(seq, field, --last));
+		writeField(seq, field, last, value);
+	}
+}
+
+void Sequencer::rotateField(sequence& seq, uint8_t field, uint8_t length, int amount){
+	while (amount < 0) amount += length;
+	while (amount >= length) amount -= length;
+	if (!amount) return;
+	reverseField(seq, field, 0, length);
+	reverseField(seq, field, 0, amount);
+	reverseField(seq, field, amount, length);
+}
+
+static uint8_t pitchClass(int note){
+	while (note < 0) note += 12;
+	while (note >= 12) note -= 12;
+	return note;
+}
+
+void Sequencer::rotateSequence(int amount){
+	if (!journal.continues(edit_track, FIELD_ROTATE, 0)) journal.begin(); //an encoder sweep undoes as one rotation
+	journal.record(edit_track, FIELD_ROTATE, 0, (uint8_t)amount, 0);
+	rotateTrack(editTrack(), amount);
+}
+
+void Sequencer::rotateTrack(track& t, int amount){
+	sequence &seq = *t.seq;
+	rotateField(seq, FIELD_STEP, seq.sequence_length, amount);
+	rotateField(seq, FIELD_GLIDE, seq.sequence_length, amount);
+	rotateField(seq, FIELD_EFFECT, seq.sequence_length, amount);
+	rotateSteps(seq.trig_matrix, seq.sequence_length, amount);
+	rotateField(seq, FIELD_PITCH, laneLength(t, LANE_PITCH), amount);
+	rotateField(seq, FIELD_OCTAVE, laneLength(t, LANE_PITCH), amount);
+	rotateField(seq, FIELD_DURATION, laneLength(t, LANE_DURATION), amount);
+	rotateField(seq, FIELD_CV, laneLength(t, LANE_CV), amount);
+	if (laneLength(t, LANE_CV) <= MOTION_STEPS) { //motion of a longer lane stays where it was recorded
+		rotateSteps(seq.motion, laneLength(t, LANE_CV), amount);
+	}
+	moveLocks(seq, amount, false);
+	rebuildPitchPool(t);
+}
+
+void Sequencer::reverseSequence(){ //retrograde
+	journal.begin();
+	journal.record(edit_track, FIELD_REVERSE, 0, 1, 0);
+	reverseTrack(editTrack());
+}
+
+void Sequencer::reverseTrack(track& t){
+	sequence &seq = *t.seq;
+	reverseField(seq, FIELD_STEP, 0, seq.sequence_length);
+	reverseField(seq, FIELD_GLIDE, 0, seq.sequence_length);
+	reverseField(seq, FIELD_EFFECT, 0, seq.sequence_length);
+	reverseSteps(seq.trig_matrix, 0, seq.sequence_length);
+	reverseField(seq, FIELD_PITCH, 0, laneLength(t, LANE_PITCH));
+	reverseField(seq, FIELD_OCTAVE, 0, laneLength(t, LANE_PITCH));
+	reverseField(seq, FIELD_DURATION, 0, laneLength(t, LANE_DURATION));
+	reverseField(seq, FIELD_CV, 0, laneLength(t, LANE_CV));
+	if (laneLength(t, LANE_CV) <= MOTION_STEPS) {
+		reverseSteps(seq.motion, 0, laneLength(t, LANE_CV));
+	}
+	moveLocks(seq, 0, true);
+	rebuildPitchPool(t);
+}
+
+void Sequencer::invertPitches(){ //mirror every note around the selected step's note, then snap back into the scale
+	track &t = editTrack();
+	int pivot = pivotNote(t);
+	bool journaled = beginNoteTransform(t);
+	for (byte i = 0; i < laneLength(t, LANE_PITCH); i++) {
+		setNote(t, i, 2 * pivot - (t.seq->steps[i].octave * 12 + t.seq->steps[i].pitch), journaled);
+	}
+	rebuildPitchPool(t);
+}
+
+void Sequencer::transposeInScale(int degrees){ //move every note by scale degrees rather than semitones
+	track &t = editTrack();
+	int8_t direction = degrees > 0 ? 1 : -1;
+	bool journaled = beginNoteTransform(t);
+	for (byte i = 0; i < laneLength(t, LANE_PITCH); i++) {
+		int note = t.seq->steps[i].octave * 12 + t.seq->steps[i].pitch;
+		for (int d = degrees; d != 0; d -= direction) {
+			do {
+				note += direction;
+			} while (!scaleHasTone(t, pitchClass(note)));
+		}
+		setNote(t, i, note, journaled);
+	}
+	rebuildPitchPool(t);
+}
+
+void Sequencer::foldOctaves(){ //bring every note into the octave that starts at the selected step's note
+	track &t = editTrack();
+	int pivot = pivotNote(t);
+	bool journaled = beginNoteTransform(t);
+	for (byte i = 0; i < laneLength(t, LANE_PITCH); i++) {
+		int note = t.seq->steps[i].octave * 12 + t.seq->steps[i].pitch;
+		while (note < pivot) note += 12;
+		while (note >= pivot + 12) note -= 12;
+		setNote(t, i, note, journaled);
+	}
+	rebuildPitchPool(t);
+}
+
+bool Sequencer::beginNoteTransform(track& t){ //true if the notes are journaled one by one, else the track is kept in a snapshot
+	if (laneLength(t, LANE_PITCH) * 2 <= TRANSFORM_JOURNAL_LIMIT) { //a pitch and an octave per step
+		journal.begin();
+		return true;
+	}
+	snapshotTrack(&t - tracks, FIELD_TRANSFORM, TRANSFORM_NOTES);
+	return false;
+}
+
+int Sequencer::pivotNote(track& t){
+	uint8_t pivot_step = min(selected_step, laneLength(t, LANE_PITCH) - 1);
+	return t.seq->steps[pivot_step].octave * 12 + t.seq->steps[pivot_step].pitch;
+}
+
+void Sequencer::setNote(track& t, uint8_t step, int note, bool journaled){ //store a note relative to octave 0 as an in-scale pitch 0-11 plus octave
+	note = min(max(note, -48), 59); //octave pot range -4/+4
+	uint8_t pitch = pitchClass(note);
+	if (!scaleHasTone(t, pitch)) {
+		pitch += scaleCorrection(t, pitch); //can land on 12, the root an octave up
+	}
+	uint8_t octave = (note - pitchClass(note)) / 12;
+	if (journaled) {
+		setField(t, FIELD_PITCH, step, pitch);
+		setField(t, FIELD_OCTAVE, step, octave);
+	} else {
+		writeField(*t.seq, FIELD_PITCH, step, pitch);
+		writeField(*t.seq, FIELD_OCTAVE, step, octave);
+	}
+}
+
+uint8_t Sequencer::undo(){ //revert the newest group of edits, returns how many values changed
+	uint8_t count = journal.undo();
+	uint8_t first = journal.getApplied();
+	for (uint8_t i = count; i > 0; i--) { //newest first so repeated edits unwind in order
+		applyJournalEntry(journal.entry(first + i - 1), true);
+	}
+	if (count) refreshAfterHistory();
+	return count;
+}
+
+uint8_t Sequencer::redo(){
+	uint8_t first = journal.getApplied();
+	uint8_t count = journal.redo();
+	for (uint8_t i = 0; i < count; i++) {
+		applyJournalEntry(journal.entry(first + i), false);
+	}
+	if (count) refreshAfterHistory();
+	return count;
+}
+
+void Sequencer::clearHistory(){
+	journal.clear();
+	track_snapshots = 0;
+}
+
+void Sequencer::applyJournalEntry(const journal_entry& entry, bool undo){
+	track &t = tracks[entry.getTrack()];
+	switch (entry.getField()) {
+		case FIELD_ROTATE: rotateTrack(t, undo ? -(int8_t)entry.old_value : (int8_t)entry.old_value); break;
+		case FIELD_REVERSE: if (entry.old_value & 1) reverseTrack(t); break; //two reversals cancel out
+		case FIELD_TRANSFORM: t.seq = shadowBank(entry.getTrack()); break; //the snapshot holds the other side of it
+		case FIELD_CLEAR: if (undo) restoreTrack(entry.getTrack()); else clearTrack(entry.getTrack()); break;
+		default: writeField(*t.seq, entry.getField(), entry.getStep(), undo ? entry.getOldValue() : entry.getNewValue());
+	}
+}
+
+void Sequencer::refreshAfterHistory(){ //derived state of both tracks, any of their values may have moved
+	setTempoFromSequence();
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		track &t = tracks[i];
+		t.prev_sequence_length = t.seq->sequence_length;
+		for (byte lane = 0; lane < LANE_COUNT; lane++) {
+			if (t.seq->lane_length[lane] && t.lane_step[lane] >= t.seq->lane_length[lane]) {
+				t.lane_step[lane] = t.seq->lane_length[lane] - 1;
+			}
+		}
+		resolveLocks(t);
+		updateRollCalc(t);
+		updateStutterCalc(t);
+		rebuildPitchPool(t);
+	}
+}
+
+uint16_t Sequencer::readField(sequence& seq, uint8_t field, uint8_t step){ //signed values come back as their raw byte
+	switch (field) {
+		case FIELD_PITCH: return (uint8_t)seq.steps[step].pitch;
+		case FIELD_OCTAVE: return (uint8_t)seq.steps[step].octave;
+		case FIELD_DURATION: return seq.steps[step].duration;
+		case FIELD_CV: return (uint8_t)seq.steps[step].cv;
+		case FIELD_STEP: return seq.steps[step].gate;
+		case FIELD_GLIDE: return seq.steps[step].glide;
+		case FIELD_EFFECT: return seq.steps[step].effect;
+		case FIELD_TRIG: return seq.trig_matrix[step];
+		case FIELD_LENGTH: return seq.sequence_length;
+		case FIELD_GLIDE_LENGTH: return seq.glide_length;
+		case FIELD_SCALE: return seq.scale;
+		case FIELD_EFFECT_TYPE: return seq.effect;
+		case FIELD_EFFECT_DEPTH: return seq.effect_depth;
+		case FIELD_TRANSPOSE: return (uint8_t)seq.transpose;
+		case FIELD_CV_MODE: return (uint8_t)seq.cv_mode;
+		case FIELD_SWING: return seq.swing;
+	}
+	if (field >= FIELD_LANE_LENGTH && field < FIELD_LANE_LENGTH + LANE_COUNT) {
+		return seq.lane_length[field - FIELD_LANE_LENGTH];
+	}
+	if (field >= FIELD_LOCK && field < FIELD_LOCK + LOCK_PARAM_COUNT) {
+		if (!stepHasLocks(seq, step)) return LOCK_NONE;
+		param_lock &lock = seq.locks[lockSlot(seq, step)];
+		return (lock.mask & (1 << (field - FIELD_LOCK))) ? lock.values[field - FIELD_LOCK] : LOCK_NONE;
+	}
+	return 0;
+}
+
+void Sequencer::writeField(sequence& seq, uint8_t field, uint8_t step, uint16_t value){
+	switch (field) {
+		case FIELD_PITCH: seq.steps[step].pitch = value; break;
+		case FIELD_OCTAVE: seq.steps[step].octave = value; break;
+		case FIELD_DURATION: seq.steps[step].duration = value; break;
+		case FIELD_CV: seq.steps[step].cv = value; break;
+		case FIELD_STEP: seq.steps[step].gate = value; break;
+		case FIELD_GLIDE: seq.steps[step].glide = value; break;
+		case FIELD_EFFECT: seq.steps[step].effect = value; break;
+		case FIELD_TRIG: seq.trig_matrix[step] = value; break;
+		case FIELD_LENGTH: seq.sequence_length = value; break;
+		case FIELD_GLIDE_LENGTH: seq.glide_length = value; break;
+		case FIELD_SCALE: seq.scale = value; break;
+		case FIELD_EFFECT_TYPE: seq.effect = value; break;
+		case FIELD_EFFECT_DEPTH: seq.effect_depth = value; break;
+		case FIELD_TRANSPOSE: seq.transpose = value; break;
+		case FIELD_CV_MODE: seq.cv_mode = value; break;
+		case FIELD_SWING: seq.swing = value; break;
+		default:
+			if (field >= FIELD_LANE_LENGTH && field < FIELD_LANE_LENGTH + LANE_COUNT) {
+				seq.lane_length[field - FIELD_LANE_LENGTH] = value;
+			} else if (field >= FIELD_LOCK && field < FIELD_LOCK + LOCK_PARAM_COUNT) {
+				writeLock(seq, field - FIELD_LOCK, step, value);
+			}
+	}
+}
+
+void Sequencer::setField(track& t, uint8_t field, uint8_t step, uint16_t value){ //write a value, journaled in the open group
+	uint16_t old_value = readField(*t.seq, field, step);
+	if (old_value == value) return;
+	writeField(*t.seq, field, step, value);
+	if (readField(*t.seq, field, step) != value) return; //refused by a full lock table, nothing to undo
+	journal.record(&t - tracks, field, step, old_value, value);
+}
+
+void Sequencer::editField(track& t, uint8_t field, uint8_t step, uint16_t value){ //a single edit from the panel
+	if (readField(*t.seq, field, step) == value) return; //an unchanged reading mustn't cut off the redo history
+	if (!seq_record_mode && !journal.continues(&t - tracks, field, step)) {
+		journal.begin(); //live recording keeps the whole pass in one group
+	}
+	setField(t, field, step, value);
+}
+
+int Sequencer::incrementLock(uint8_t step, uint8_t param, int amount){ //lock a sequence setting on one step, turning below its minimum unlocks it
+	track &t = param == LOCK_SWING ? tracks[0] : editTrack(); //swing is shared, so are its locks
+	sequence &seq = *t.seq;
+	uint8_t field = FIELD_LOCK + param;
+	uint16_t lock = readField(seq, field, step);
+	uint16_t locked_effect = readField(seq, FIELD_LOCK + LOCK_EFFECT, step);
+	uint8_t effect = locked_effect == LOCK_NONE ? seq.effect : locked_effect; //depth ranges follow the effect the step plays
+	uint8_t min = 0;
+	uint8_t base = 0; //what the step plays without a lock
+	switch (param) {
+		case LOCK_TRANSPOSE: base = seq.transpose; break;
+		case LOCK_GLIDE: base = seq.glide_length; min = 1; break;
+		case LOCK_EFFECT: base = seq.effect; break;
+		case LOCK_EFFECT_DEPTH: base = stepEffectDepth(effect, seq.effect_depth, 0); min = stepEffectDepth(effect, 0, 0); break;
+		case LOCK_SWING: base = seq.swing; min = 10; break;
+	}
+	uint8_t value = lock == LOCK_NONE ? base : lock;
+
+	if (amount < 0 && lock != LOCK_NONE && value == min) {
+		lock = LOCK_NONE;
+	} else if (amount != 0) {
+		switch (param) {
+			case LOCK_TRANSPOSE: lock = getMinMaxParam(value, amount, 0, 48); break;
+			case LOCK_GLIDE: lock = getMinMaxParam(value, amount, 1, 255); break;
+			case LOCK_EFFECT: lock = getMinMaxParam(value, amount, 0, 16); break;
+			case LOCK_EFFECT_DEPTH: lock = stepEffectDepth(effect, value, amount); break;
+			case LOCK_SWING: lock = getMinMaxParam(value, amount, 10, 90); break;
+		}
+	}
+
+	if (param == LOCK_EFFECT) { //a locked effect brings its own depth
+		if (lock != readField(seq, field, step)) {
+			journal.begin();
+			setField(t, field, step, lock);
+			setField(t, FIELD_LOCK + LOCK_EFFECT_DEPTH, step, lock == LOCK_NONE ? LOCK_NONE : effectDefaultDepth(lock, seq.effect_depth, seq.glide_length));
+		}
+	} else {
+		editField(t, field, step, lock);
+	}
+	if (step == t.active_step) {
+		resolveLocks(t); //heard right away when the step is playing
+	}
+
+	if (lock == LOCK_NONE) lock = base;
+	switch (param) {
+		case LOCK_TRANSPOSE: return lock - 24;
+		case LOCK_EFFECT_DEPTH: return effectDepthDisplay(effect, lock);
+	}
+	return lock;
+}
+
+bool Sequencer::getLocked(uint8_t step, uint8_t param){ //step overrides the sequence setting
+	sequence &seq = param == LOCK_SWING ? *tracks[0].seq : *editTrack().seq;
+	return readField(seq, FIELD_LOCK + param, step) != LOCK_NONE;
+}
+
+bool Sequencer::stepHasLocks(sequence& seq, uint8_t step){
+	return seq.lock_steps[step >> 3] & (1 << (step & 7));
+}
+
+uint8_t Sequencer::lockSlot(sequence& seq, uint8_t step){ //entries are in step order, so a step's slot is the number of locked steps before it
+	uint8_t slot = 0;
+	for (byte i = 0; i < (step >> 3); i++) {
+		slot += __builtin_popcount(seq.lock_steps[i]);
+	}
+	return slot + __builtin_popcount(seq.lock_steps[step >> 3] & ((1 << (step & 7)) - 1));
+}
+
+void Sequencer::writeLock(sequence& seq, uint8_t param, uint8_t step, uint16_t value){
+	uint8_t slot = lockSlot(seq, step);
+	param_lock &lock = seq.locks[slot];
+	if (value == LOCK_NONE) {
+		if (!stepHasLocks(seq, step)) return;
+		lock.mask &= ~(1 << param);
+		if (lock.mask) return;
+		memmove(&seq.locks[slot], &seq.locks[slot + 1], sizeof(param_lock) * (seq.lock_count - slot - 1));
+		seq.lock_count--;
+		seq.lock_steps[step >> 3] &= ~(1 << (step & 7));
+		return;
+	}
+	if (!stepHasLocks(seq, step)) {
+		if (seq.lock_count == LOCK_SLOTS) return; //table full, the lock is refused
+		memmove(&seq.locks[slot + 1], &seq.locks[slot], sizeof(param_lock) * (seq.lock_count - slot));
+		seq.lock_count++;
+		seq.lock_steps[step >> 3] |= 1 << (step & 7);
+		lock.mask = 0;
+	}
+	lock.mask |= 1 << param;
+	lock.values[param] = value;
+}
+
+void Sequencer::moveLocks(sequence& seq, int amount, bool reverse){ //locks follow their steps through rotate and reverse
+	if (!seq.lock_count) return;
+	param_lock moved[LOCK_SLOTS];
+	uint8_t moved_steps[sizeof(seq.lock_steps)] = { 0 };
+	uint8_t length = seq.sequence_length;
+	uint8_t count = 0;
+	for (byte step = 0; step < SEQUENCE_MAX_LENGTH; step++) { //walking the new positions in order keeps the table sorted
+		int from = step;
+		if (step < length) {
+			from = reverse ? length - 1 - step : step - amount;
+			while (from < 0) from += length;
+			while (from >= length) from -= length;
+		}
+		if (!stepHasLocks(seq, from)) continue;
+		moved[count++] = seq.locks[lockSlot(seq, from)];
+		moved_steps[step >> 3] |= 1 << (step & 7);
+	}
+	memcpy(seq.locks, moved, sizeof(param_lock) * count);
+	memcpy(seq.lock_steps, moved_steps, sizeof(moved_steps));
+}
+
+void Sequencer::resolveLocks(track& t){ //pick up the active step's locks, a sequence without any costs one bit test per step
+	bool had_locks = t.lock.mask;
+	t.lock.mask = 0;
+	if (t.active_step >= 0 && stepHasLocks(*t.seq, t.active_step)) {
+		t.lock = t.seq->locks[lockSlot(*t.seq, t.active_step)];
+	}
+	resolveModulation(t);
+	if (!had_locks && !t.lock.mask) return;
+	uint8_t effect = lockedEffect(t);
+	t.turing_mode = effect >= EFFECT_TURING1 && effect <= EFFECT_TURING3;
+	updateGlideCalc(t);
+	updateRollCalc(t);
+	updateStutterCalc(t);
+	if (&t == tracks) updateSwingCalc();
+}
+
+//ranges of the settings a route can move, effect depth follows the effect instead
+static const uint8_t mod_min[LOCK_PARAM_COUNT] = { 0, 1, 0, 0, 10 };
+static const uint8_t mod_max[LOCK_PARAM_COUNT] = { 48, 255, 16, 0, 90 };
+
+void Sequencer::resolveModulation(track& t){ //cv inputs lock the settings they move for the whole step, so nothing downstream knows about routes
+	int offsets[MOD_DESTINATIONS] = { 0 };
+	bool modulated = false;
+	for (byte r = 0; r < MOD_ROUTES; r++) {
+		mod_route &route = mod_routes[r];
+		if (route.source == MOD_OFF) continue;
+		offsets[route.destination] += (mod_inputs[route.source - 1] * route.amount + 128) >> 8; //16 bit, rounded to the nearest unit
+		modulated = true;
+	}
+	t.cv2_offset = 0;
+	if (!modulated) return;
+	for (byte p = 0; p < LOCK_PARAM_COUNT; p++) { //in LOCK_ order, so a modulated effect picks the depth range
+		if (!offsets[p]) continue;
+		uint8_t value = 0;
+		uint8_t min = mod_min[p];
+		uint8_t max = mod_max[p];
+		switch (p) {
+			case LOCK_TRANSPOSE: value = lockedValue(t, p, t.seq->transpose); break;
+			case LOCK_GLIDE: value = lockedGlideLength(t); break;
+			case LOCK_EFFECT: value = lockedEffect(t); break;
+			case LOCK_EFFECT_DEPTH:
+				value = lockedEffectDepth(t);
+				min = stepEffectDepth(lockedEffect(t), 0, 0);
+				max = stepEffectDepth(lockedEffect(t), 255, 0);
+				break;
+			case LOCK_SWING: value = lockedValue(t, p, t.seq->swing); break;
+		}
+		t.lock.mask |= 1 << p;
+		t.lock.values[p] = getMinMaxParam(value, offsets[p], min, max);
+	}
+	t.cv2_offset = constrain(offsets[MOD_CV2], -100, 100);
+}
+
+void Sequencer::setModInput(uint8_t input, int analogValue){ //read once per step by resolveModulation
+	mod_inputs[input] = analogValue >> 2;
+}
+
+int Sequencer::incrementModSource(uint8_t route, int amount){
+	mod_routes[route].source = getMinMaxParam(mod_routes[route].source, amount, MOD_OFF, MOD_INPUTS);
+	mod_routes_edited |= 1 << route;
+	return mod_routes[route].source;
+}
+
+int Sequencer::incrementModDestination(uint8_t route, int amount){
+	mod_routes[route].destination = getMinMaxParam(mod_routes[route].destination, amount, 0, MOD_DESTINATIONS - 1);
+	mod_routes_edited |= 1 << route;
+	return mod_routes[route].destination;
+}
+
+int Sequencer::incrementModAmount(uint8_t route, int amount){
+	mod_routes[route].amount = getMinMaxParam(mod_routes[route].amount, amount, -MOD_MAX_AMOUNT, MOD_MAX_AMOUNT);
+	mod_routes_edited |= 1 << route;
+	return mod_routes[route].amount;
+}
+
+uint8_t Sequencer::getModSource(uint8_t route){
+	return mod_routes[route].source;
+}
+
+void Sequencer::writeModRoutes(){ //routes belong to the panel rather than a patch, like the calibration
+	if (!mod_routes_edited) return;
+	for (byte r = 0; r < MOD_ROUTES; r++) { //each byte written blocks for ~3.4 ms, so only once editing is done
+		if (!(mod_routes_edited & (1 << r))) continue;
+		calibrationVar->writeModRoute(r, 0, mod_routes[r].source);
+		calibrationVar->writeModRoute(r, 1, mod_routes[r].destination);
+		calibrationVar->writeModRoute(r, 2, (uint8_t)mod_routes[r].amount);
+	}
+	mod_routes_edited = 0;
+}
+
+int8_t Sequencer::offsetCv2(track& t, int8_t cv){ //kept within the range of the cv mode
+	switch (t.seq->cv_mode) {
+		case 2: return constrain(cv + t.cv2_offset, -24, 24);
+		case 3: return constrain(cv + t.cv2_offset, 12, 60);
+	}
+	return constrain(cv + t.cv2_offset, 0, 100);
+}
+
+uint8_t Sequencer::laneLength(track& t, uint8_t lane){
+	return t.seq->lane_length[lane] ? t.seq->lane_length[lane] : t.seq->sequence_length;
+}
+
+void Sequencer::setFill(bool state){
+	fill_active = state;
+}
+
+void Sequencer::fillEuclid(uint8_t first_step, uint8_t steps, uint8_t hits, uint8_t rotation){
+	//spread hits evenly over steps (bresenham, a rotation of bjorklund's pattern), first hit on the rotation
+	track &t = editTrack();
+	bool journaled = steps <= TRANSFORM_JOURNAL_LIMIT;
+	if (journaled) {
+		journal.begin();
+	} else if (!journal.continues(edit_track, FIELD_TRANSFORM, TRANSFORM_EUCLID)) { //a sweep of the hits undoes as one fill
+		snapshotTrack(edit_track, FIELD_TRANSFORM, TRANSFORM_EUCLID);
+	}
+	uint8_t bucket = hits ? steps - hits : 0; //start full so the first step is a hit
+	uint8_t step = rotation;
+	for (byte i = 0; i < steps; i++) {
+		bucket += hits;
+		bool hit = bucket >= steps;
+		if (hit) bucket -= steps;
+		if (journaled) {
+			setField(t, FIELD_STEP, first_step + step, hit);
+		} else {
+			writeField(*t.seq, FIELD_STEP, first_step + step, hit);
+		}
+		if (++step == steps) step = 0;
+	}
+	rebuildPitchPool(t);
+}
+
+int Sequencer::incrementLaneLength(uint8_t lane, int amount){
+	track &t = editTrack();
+	uint8_t prev_length = t.seq->lane_length[lane];
+	if (!prev_length && amount > 0) {
+		t.lane_step[lane] = t.current_step; //split off from where the gate lane is
+	}
+	editField(t, FIELD_LANE_LENGTH + lane, 0, getMinMaxParam(prev_length, amount, 0, SEQUENCE_MAX_LENGTH));
+	uint8_t length = t.seq->lane_length[lane];
+	if (t.lane_step[lane] >= length) {
+		t.lane_step[lane] = length - 1; //wraps to the first step on the next clock
+	}
+	if (lane == LANE_PITCH && length != prev_length) {
+		rebuildPitchPool(t);
+	}
+	return length;
 }
 
 
 void Sequencer::selectStep(int stepnum){
-	if (selected_step == stepnum || !active_sequence.step_matrix[stepnum]) { //require 2 presses to turn active steps off, so they can be selected/edited without double-tapping //TODO maybe implement hold-to-deactivate
-        active_sequence.step_matrix[stepnum] = !active_sequence.step_matrix[stepnum];
+	track &t = editTrack();
+	if (selected_step == stepnum || !t.seq->steps[stepnum].gate) { //require 2 presses to turn active steps off, so they can be selected/edited without double-tapping, holding the key also turns them off (see Ui::onLongPress)
+		editField(t, FIELD_STEP, stepnum, !t.seq->steps[stepnum].gate);
+		if (pitchIsPlayable(t, stepnum)) {
+			addToPitchPool(t, stepnum);
+		} else {
+			removeFromPitchPool(t, stepnum);
+		}
     }
     selected_step = stepnum;
 }
@@ -771,48 +1617,55 @@ int8_t Sequencer::setMinMaxParam(int8_t& param, int8_t increment, int8_t min, in
 
 
 bool Sequencer::getStepOnOff(int stepnum){
-	return active_sequence.step_matrix[stepnum];
+	return editTrack().seq->steps[stepnum].gate;
 }
 
 bool Sequencer::toggleGlide(){
-	active_sequence.glide_matrix[selected_step] = !active_sequence.glide_matrix[selected_step];
-	return active_sequence.glide_matrix[selected_step];
+	sequence &seq = *editTrack().seq;
+	editField(editTrack(), FIELD_GLIDE, selected_step, !seq.steps[selected_step].glide);
+	return seq.steps[selected_step].glide;
 }
 
 bool Sequencer::setPitch(int newVal){
+	track &t = editTrack();
 	//quantize pitches to scale
-	if (current_scale_tones[newVal >= 0 ? newVal : newVal + 12] == false) return false;
+	if (!scaleHasTone(t, newVal)) return false;
 
-	bool changed = active_sequence.pitch_matrix[editedStep()] != newVal;
-	active_sequence.pitch_matrix[editedStep()] = newVal;
+	bool changed = t.seq->steps[editedStep(LANE_PITCH)].pitch != newVal;
+	editField(t, FIELD_PITCH, editedStep(LANE_PITCH), (uint8_t)newVal);
+	if (t.pitch_pool_slot[editedStep(LANE_PITCH)] >= 0) {
+		t.active_pitches[t.pitch_pool_slot[editedStep(LANE_PITCH)]] = newVal;
+	}
 	return changed;
 }
 bool Sequencer::setOctave(int8_t newVal){
-	bool changed = active_sequence.octave_matrix[editedStep()] != newVal;
-	active_sequence.octave_matrix[editedStep()] = newVal;
+	sequence &seq = *editTrack().seq;
+	bool changed = seq.steps[editedStep(LANE_PITCH)].octave != newVal;
+	editField(editTrack(), FIELD_OCTAVE, editedStep(LANE_PITCH), (uint8_t)newVal);
 	return changed;
 }
 bool Sequencer::setDuration(uint16_t newVal){
-	bool changed = active_sequence.duration_matrix[editedStep()] != newVal;
-	active_sequence.duration_matrix[editedStep()] = newVal;
+	sequence &seq = *editTrack().seq;
+	bool changed = seq.steps[editedStep(LANE_DURATION)].duration != newVal;
+	editField(editTrack(), FIELD_DURATION, editedStep(LANE_DURATION), newVal);
 	return changed;
 }
-bool Sequencer::setCv2(int analogValue){
-	int newVal = getCv2DisplayValue(analogValue);
-	if (active_sequence.cv_mode == 3){ 
-		if (current_scale_tones[newVal % 12] == false) return false; //skip out-of-scale tones for quantization
-	} else if (active_sequence.cv_mode == 1 && seq_record_mode) { //while recording LFO mode, use real-time values
-		lfo_target = newVal;
+bool Sequencer::setCv2(int newVal){
+	track &t = editTrack();
+	if (t.seq->cv_mode == 3){
+		if (!scaleHasTone(t, newVal % 12)) return false; //skip out-of-scale tones for quantization
+	} else if (t.seq->cv_mode == 1 && seq_record_mode) { //while recording LFO mode, use real-time values
+		t.lfo_target = newVal;
 		//dacVar->setOutput(1, GAIN_2, 1, newVal * 40);
 	}
-	bool changed = active_sequence.cv_matrix[editedStep()] != newVal;
-	active_sequence.cv_matrix[editedStep()] = newVal;
+	bool changed = t.seq->steps[editedStep(LANE_CV)].cv != newVal;
+	editField(t, FIELD_CV, editedStep(LANE_CV), (uint8_t)newVal);
 	return changed;
 }
 
 int8_t Sequencer::getCv2DisplayValue(int analogValue){
 	int newVal = 0;
-	switch (active_sequence.cv_mode) {
+	switch (editTrack().seq->cv_mode) {
 		case 0:
 		case 1:
 			newVal = analogValue / 10.23; //convert from 0-1024 to 0-100 for int8_t
@@ -825,68 +1678,71 @@ int8_t Sequencer::getCv2DisplayValue(int analogValue){
 			break;
 	}
 	return newVal;
-	//return active_sequence.cv_matrix[selected_step];
+	//return editTrack().seq->steps[selected_step].cv;
 }
 
 void Sequencer::setTempoFromSequence(){
 	if (!play_active) { //if sequence is already playing, continue in time
-		tempo_millis = 15000 / active_sequence.sequence_tempo;
+		tempo_millis = 15000 / tracks[0].seq->sequence_tempo;
 		calculated_tempo = tempo_millis;
 	}
 	incrementTempo(0); //sets swing params
-	updateGlideCalc();
-	incrementScale(0);
-	incrementEffectDepth(0);
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		track &trk = tracks[t];
+		updateGlideCalc(trk);
+		loadScale(trk);
+		trk.turing_mode = lockedEffect(trk) >= EFFECT_TURING1 && lockedEffect(trk) <= EFFECT_TURING3;
+		if (!trackEnabled(trk)) {
+			setGate(trk, false);
+		}
+	}
 }
 
-void Sequencer::updateGlideCalc(){
-	if (seq_effect_mode && active_sequence.effect == EFFECT_GLIDE) {
-		glide_duration = active_sequence.effect_depth * 4;
+void Sequencer::updateGlideCalc(track& t){
+	int glide_duration;
+	if (t.effect_mode && lockedEffect(t) == EFFECT_GLIDE) {
+		glide_duration = lockedEffectDepth(t) * 4;
 	} else {
-		glide_duration = active_sequence.glide_length;
+		glide_duration = lockedGlideLength(t);
 	}
-	glide_time = float(glide_duration) / 100.0 * calculated_tempo;
+	t.glide_time = float(glide_duration) / 100.0 * getStepLength(t);
 }
 
-void Sequencer::updateRollCalc(){
-	calculated_roll = calculated_tempo / active_sequence.effect_depth;
+void Sequencer::updateRollCalc(track& t){
+	t.calculated_roll = getStepLength(t) / max(lockedEffectDepth(t), 1);
 }
 
-void Sequencer::updateStutterCalc(){
-	calculated_stutter = calculated_tempo * float(active_sequence.effect_depth) / 100.0;
+void Sequencer::updateStutterCalc(track& t){
+	t.calculated_stutter = getStepLength(t) * float(lockedEffectDepth(t)) / 100.0;
 }
 
-uint8_t Sequencer::editedStep(){
-	return (seq_record_mode ? active_step : selected_step);
+uint8_t Sequencer::editedStep(uint8_t lane){ //live recording writes to where each lane is playing
+	return (seq_record_mode ? editTrack().active_lane_step[lane] : selected_step);
 }
 
 bool Sequencer::currentStepActive(){
-	return current_step == active_step;
+	return editTrack().current_step == editTrack().active_step;
 }
 
 bool Sequencer::getGlide(){
-	return active_sequence.glide_matrix[selected_step];
+	return editTrack().seq->steps[selected_step].glide;
 }
 
 int Sequencer::getPitch(){
-	return active_sequence.pitch_matrix[selected_step];
+	return editTrack().seq->steps[selected_step].pitch;
 }
 int Sequencer::getOctave(){
-	return active_sequence.octave_matrix[selected_step];
+	return editTrack().seq->steps[selected_step].octave;
 }
 int Sequencer::getDuration(){
-	return active_sequence.duration_matrix[selected_step];
+	return editTrack().seq->steps[selected_step].duration;
 }
 int Sequencer::getCv(){
-	// switch (active_sequence.cv_mode) {
+	// switch (editTrack().seq->cv_mode) {
 	// 	case 0: return_active_sequencebreak;
 	// 	case 1: break;
 	// }
-	return active_sequence.cv_matrix[selected_step];
-}
-
-bool *Sequencer::getStepMatrix(){
-	return active_sequence.step_matrix;
+	return editTrack().seq->steps[selected_step].cv;
 }
 
 int Sequencer::getSelectedStep(){
@@ -894,14 +1750,14 @@ int Sequencer::getSelectedStep(){
 }
 
 int Sequencer::getMidiPitch(int pitch, int octave){
-	double midinote = ((double(octave) + 3) * 12) + double(pitch) + active_sequence.transpose - 24;
+	double midinote = ((double(octave) + 3) * 12) + double(pitch) + editTrack().seq->transpose - 24;
 
 	return min(max(midinote, 0), 127); //don't show unusable pitch adjustments at extreme octaves
 }
 
 char *Sequencer::getPitchName(uint8_t note){
-	//uint8_t note = (getPitch() + active_sequence.transpose) % 12; //convert -12/+12 to 0 - 11
-	
+	//uint8_t note = (getPitch() + editTrack().seq->transpose) % 12; //convert -12/+12 to 0 - 11
+
 	//set note name
 	strcpy_P(pitchname, (char *)pgm_read_word(&(note_names[note % 12])));  // Necessary casts and dereferencing, just copy (for PROGMEM keywords in flash)
 
@@ -911,30 +1767,20 @@ char *Sequencer::getPitchName(uint8_t note){
 	return pitchname;
 }
 
-void Sequencer::setEffectMode(bool state){
-	seq_effect_mode = state;
-	repeat_step_origin  = current_step;
-	if (active_sequence.effect == EFFECT_GLIDE) {
-		updateGlideCalc();
-	} else if (active_sequence.effect == EFFECT_FREEZE) {
-		digitalWrite(GATE_PIN, state ? HIGH : LOW);
-		gate_active = state;
-	}  else if (active_sequence.effect == EFFECT_STOP) {
-		note_reached = false;
-	} else if (active_sequence.effect == EFFECT_TURING2) {
-		//initialize current note set used for randomization
-		num_active_pitches = 0;
-		for (int i = 0; i < active_sequence.sequence_length; i++) {
-			if (active_sequence.step_matrix[i]) {
-				active_pitches[num_active_pitches] = active_sequence.pitch_matrix[i];
-				num_active_pitches += 1;
-			}
-		}
-
-	} else if (active_sequence.effect == EFFECT_VIBRATO) {
-		dacVar->setOutput(0, GAIN_2, 1, current_note_value);
-		if (active_sequence.cv_mode == 3 || active_sequence.cv_mode == 2) {
-			dacVar->setOutput(1, GAIN_2, 1, current_note_value2);
+void Sequencer::setEffectMode(track& t, bool state){
+	sequence &seq = *t.seq;
+	t.effect_mode = state;
+	t.repeat_step_origin  = t.current_step;
+	if (lockedEffect(t) == EFFECT_GLIDE) {
+		updateGlideCalc(t);
+	} else if (lockedEffect(t) == EFFECT_FREEZE) {
+		setGate(t, state);
+	}  else if (lockedEffect(t) == EFFECT_STOP) {
+		t.note_reached = false;
+	} else if (lockedEffect(t) == EFFECT_VIBRATO) {
+		dacVar->setOutput(t.output, GAIN_2, 1, t.current_note_value);
+		if (hasCv2(t) && (seq.cv_mode == 3 || seq.cv_mode == 2)) {
+			dacVar->setOutput(1, GAIN_2, 1, t.current_note_value2);
 		}
 	}
 }
@@ -944,104 +1790,188 @@ void Sequencer::onMutateButton(bool state){
 	onMutate(state);
 }
 
-void Sequencer::onMutate(bool state){
-	setEffectMode(state);
+void Sequencer::onMutate(bool state){ //mutate engages the effect of every running track
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		if (trackEnabled(tracks[i])) {
+			setEffectMode(tracks[i], state);
+		}
+	}
 	if (seq_record_mode && mutate_button) {
-		active_sequence.effect_matrix[current_step] = state;
+		editTrack().seq->steps[editTrack().current_step].effect = state;
 		seq_recording_effect = state;
 	}
 }
 
 
 void Sequencer::setRecordMode(bool state){
+	if (state) journal.begin(); //a live recording pass undoes as a whole
 	seq_record_mode = state;
-	if (!state)	seq_recording_effect = false; 
+	motion_recording = false; //armed again by the first cv2 knob move
+	if (!state)	seq_recording_effect = false;
 }
 
-int Sequencer::incrementSongNextSeq(int amount){
-	active_sequence.song_next_seq = getMinMaxParam(active_sequence.song_next_seq, amount, 0, 99);
-	if (active_sequence.song_next_seq > 0 && active_sequence.song_loops > 0) {
-		song_mode = true;
-	} else {
-		song_mode = false;
+Song& Sequencer::getSong(){
+	return song;
+}
+
+bool Sequencer::songOnLastLoop(){ //time to read the next entry's patch
+	return song.isPlaying() && song_mode_loops + 1 >= song.entry(song.getPosition()).repeats;
+}
+
+sequence * Sequencer::getShadowSequence(uint8_t track_index){ //for a prefetch, which overwrites the snapshot of a clear or transform
+	if (track_snapshots & (1 << track_index)) {
+		journal.forget(track_index, FIELD_CLEAR);
+		journal.forget(track_index, FIELD_TRANSFORM);
+		track_snapshots &= ~(1 << track_index);
 	}
-	return active_sequence.song_next_seq;
+	return shadowBank(track_index);
 }
 
-int Sequencer::incrementSongLoops(int amount){
-	active_sequence.song_loops = getMinMaxParam(active_sequence.song_loops, amount, 0, 99);
-	return active_sequence.song_loops;
+sequence * Sequencer::shadowBank(uint8_t track_index){
+	sequence *banks = sequence_banks[track_index];
+	return tracks[track_index].seq == &banks[0] ? &banks[1] : &banks[0];
 }
 
-int Sequencer::getSongNextSeq(){
-	return active_sequence.song_next_seq;
+void Sequencer::swapSequences(){ //the caller sets up the new patch like after a load
+	for (byte t = 0; t < TRACK_COUNT; t++) {
+		tracks[t].seq = shadowBank(t);
+	}
 }
 
 
 sequence& Sequencer::getActiveSequence(){
-	return active_sequence;
+	return *editTrack().seq;
 }
 
 sequence * Sequencer::getSequence(){
-	return &active_sequence;
+	return editTrack().seq;
+}
+
+sequence * Sequencer::getTrackSequence(uint8_t track_index){
+	return tracks[track_index].seq;
 }
 
 void Sequencer::clearSequence(){
-	for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
-		active_sequence.pitch_matrix[i] = 0;
-		active_sequence.octave_matrix[i] = 0;
-		active_sequence.duration_matrix[i] = 80;
-		active_sequence.cv_matrix[i] = 0;
-		active_sequence.step_matrix[i] = false;
-		active_sequence.glide_matrix[i] = false;
-		active_sequence.effect_matrix[i] = false;
-	}
-	active_sequence.glide_length = 50;
-	active_sequence.sequence_length = 16;
-	active_sequence.bars = 1;
-	active_sequence.scale = 0;
-
-	active_sequence.swing = 50;
-	active_sequence.effect = 0; //mutate = repeat (0), reverse (1), octave shift (2), auto-glide (3), hold  (4)
-	active_sequence.effect_depth = 4;
-    //active_sequence.sequence_tempo = 120; //might be done in real time? probably not a good idea to change
-    active_sequence.transpose = 24;
-	active_sequence.song_next_seq = 0;
-	active_sequence.song_loops = 0;
-	active_sequence.cv_mode = 0;
-}
-
-void Sequencer::loadScale(uint8_t scale){
+	//the cleared track is kept whole in its shadow bank, which is idle until the next prefetch,
+	//so clearing undoes as one entry however dense the pattern was
+	if (journal.lastIs(edit_track, FIELD_CLEAR)) { //cleared again with nothing in between, keep the first snapshot
+		clearTrack(edit_track);
+		return;
+	}
+	snapshotTrack(edit_track, FIELD_CLEAR, 0);
+	clearTrack(edit_track);
+}
+
+void Sequencer::snapshotTrack(uint8_t track_index, uint8_t field, uint8_t argument){ //start a group undone from the track as it is now
+	journal.begin();
+	journal.forget(track_index, FIELD_CLEAR); //an older snapshot is about to be overwritten
+	journal.forget(track_index, FIELD_TRANSFORM);
+	*shadowBank(track_index) = *tracks[track_index].seq;
+	track_snapshots |= 1 << track_index;
+	journal.record(track_index, field, argument, 0, 0);
+}
+
+void Sequencer::restoreTrack(uint8_t track_index){ //undo of a clear
+	track &t = tracks[track_index];
+	*t.seq = *shadowBank(track_index);
+	t.random.seed(t.seq->random_seed);
+	loadScale(t);
+}
+
+void Sequencer::clearTrack(uint8_t track_index){
+	track &t = tracks[track_index];
+	sequence &seq = *t.seq;
+	for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) { //not journaled, clearSequence keeps a snapshot instead
+		writeField(seq, FIELD_PITCH, i, 0);
+		writeField(seq, FIELD_OCTAVE, i, 0);
+		writeField(seq, FIELD_DURATION, i, 80);
+		writeField(seq, FIELD_CV, i, 0);
+		writeField(seq, FIELD_STEP, i, false);
+		writeField(seq, FIELD_GLIDE, i, false);
+		writeField(seq, FIELD_EFFECT, i, false);
+		writeField(seq, FIELD_TRIG, i, 0);
+		for (byte p = 0; p < LOCK_PARAM_COUNT; p++) {
+			writeField(seq, FIELD_LOCK + p, i, LOCK_NONE);
+		}
+	}
+	writeField(seq, FIELD_GLIDE_LENGTH, 0, 50);
+	writeField(seq, FIELD_LENGTH, 0, 16);
+	seq.bars = 1;
+	writeField(seq, FIELD_SCALE, 0, 0);
+
+	writeField(seq, FIELD_SWING, 0, 50);
+	writeField(seq, FIELD_EFFECT_TYPE, 0, 0); //mutate = repeat (0), reverse (1), octave shift (2), auto-glide (3), hold  (4)
+	writeField(seq, FIELD_EFFECT_DEPTH, 0, 4);
+    //seq.sequence_tempo = 120; //might be done in real time? probably not a good idea to change
+	writeField(seq, FIELD_TRANSPOSE, 0, 24);
+	writeField(seq, FIELD_CV_MODE, 0, 0);
+	seq.random_seed = PRNG_DEFAULT_SEED;
+	for (byte l = 0; l < LANE_COUNT; l++) {
+		writeField(seq, FIELD_LANE_LENGTH + l, 0, 0);
+	}
+	for (byte i = 0; i < MOTION_STEPS; i++) {
+		seq.motion[i].key = MOTION_NONE;
+	}
+	//clock_division is kept, clearing a pattern shouldn't switch its track off
+	t.turing_mode = false;
+	t.random.seed(seq.random_seed);
+	loadScale(t);
+	rebuildPitchPool(t);
+}
+
+void Sequencer::loadScale(track& t){
+	t.scale_tones = 0;
 	for (byte k = 0; k < 13; k++) {
-    	current_scale_tones[k] = (bool)pgm_read_byte_near(scale_tones[scale] + k);
+		if (pgm_read_byte_near(scale_tones[t.seq->scale] + k)) {
+			t.scale_tones |= 1 << k;
+		}
   	}
 }
 
+bool Sequencer::scaleHasTone(track& t, int8_t pitch){ //pitch is -12..12 relative to the root
+	return (t.scale_tones >> (pitch >= 0 ? pitch : pitch + 12)) & 1;
+}
+
 void Sequencer::pickupPositionInNewSequence(){
 	song_mode_loops = 0;
 
-	if (prev_sequence_length != active_sequence.sequence_length) {
+	if (switch_aligned) { //switched on a bar line, the new pattern carries on from the same bar
+		switch_aligned = false;
+		for (byte i = 0; i < TRACK_COUNT; i++) {
+			track &t = tracks[i];
+			if (t.clock_step > 0) t.clock_step %= t.seq->sequence_length;
+			t.prev_sequence_length = t.seq->sequence_length;
+			if (t.current_step >= t.seq->sequence_length) t.current_step = t.clock_step;
+			if (t.step_advanced && trackEnabled(t)) {
+				decideStep(t); //this step was decided on the old pattern, before the ui switched
+			}
+		}
+		time_for_next_sequence = false;
+		return;
+	}
+
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		track &t = tracks[i];
+		if (t.prev_sequence_length == t.seq->sequence_length) continue;
+
 		//TODO test and integrate better mismatched phrase pickup
-		if (clock_step > 0) {
-			if (active_sequence.sequence_length >= prev_sequence_length && clock_step <= 4) { 
-				//when switching to a longer sequence at or near the first beat, 
+		if (t.clock_step > 0) {
+			if (t.seq->sequence_length >= t.prev_sequence_length && t.clock_step <= 4) {
+				//when switching to a longer sequence at or near the first beat,
 				//keep playhead at the beginning rather than picking up an extra bar
 				//no-op: clock_step = clock_step
-			} else { 
+			} else {
 				//by default, align next beat 1 by picking up position from end of sequence
-				clock_step = active_sequence.sequence_length - (prev_sequence_length - clock_step);
-				song_mode_loops = -1;
+				t.clock_step = t.seq->sequence_length - (t.prev_sequence_length - t.clock_step);
+				if (i == 0) song_mode_loops = -1;
 			}
 		}
-		while (clock_step < 0) {
-			clock_step += active_sequence.sequence_length;
+		while (t.clock_step < 0) {
+			t.clock_step += t.seq->sequence_length;
 		}
-		prev_sequence_length = active_sequence.sequence_length;
+		t.prev_sequence_length = t.seq->sequence_length;
 	}
 
-
-	song_mode = active_sequence.song_next_seq > 0 && active_sequence.song_loops > 0;
-	
 	time_for_next_sequence = false;
 }
 
@@ -1055,59 +1985,266 @@ bool Sequencer::timeForNextSequence(){ //return true exactly once when called
 }
 
 void Sequencer::paste(byte bar1, byte bar2) {
-	memcpy(active_sequence.step_matrix+bar2*16, active_sequence.step_matrix+bar1*16, 16);
-	memcpy(active_sequence.octave_matrix+bar2*16, active_sequence.octave_matrix+bar1*16, 16);
-	memcpy(active_sequence.pitch_matrix+bar2*16, active_sequence.pitch_matrix+bar1*16, 16);
-	memcpy(active_sequence.duration_matrix+bar2*16, active_sequence.duration_matrix+bar1*16, 32);
-	memcpy(active_sequence.cv_matrix+bar2*16, active_sequence.cv_matrix+bar1*16, 16);
-	memcpy(active_sequence.glide_matrix+bar2*16, active_sequence.glide_matrix+bar1*16, 16);
-	memcpy(active_sequence.effect_matrix+bar2*16, active_sequence.effect_matrix+bar1*16, 16);
+	track &t = editTrack();
+	journal.begin();
+	for (byte field = FIELD_PITCH; field < FIELD_LOCK + LOCK_PARAM_COUNT; field++) { //copied value by value so the journal sees each change
+		if (field > FIELD_TRIG && field < FIELD_LOCK) continue; //not per step
+		for (byte i = 0; i < 16; i++) {
+			setField(t, field, bar2*16 + i, readField(*t.seq, field, bar1*16 + i));
+		}
+	}
+	if (bar2*16 < MOTION_STEPS) { //motion only reaches over the first bars
+		if (bar1*16 < MOTION_STEPS) {
+			memcpy(t.seq->motion + bar2*16, t.seq->motion + bar1*16, 16 * sizeof(motion_step));
+		} else {
+			for (byte i = 0; i < 16; i++) t.seq->motion[bar2*16 + i].key = MOTION_NONE;
+		}
+	}
+	rebuildPitchPool(t);
 }
 
 void Sequencer::setStepRecordingMode(bool state){
+	track &t = editTrack();
 	if (state) {
-		active_sequence.step_matrix[current_step] = true;
-		step_recording_initiated_step = current_step;
-		active_step = current_step;
-		prev_note = active_note;
-		prev_note2 = active_note2;
+		journal.begin();
+		setField(t, FIELD_STEP, t.current_step, true);
+		addToPitchPool(t, t.current_step);
+		step_recording_initiated_step = t.current_step;
+		latchActiveStep(t, t.current_step);
+		t.step_fires = true;
+		step_recording_duration_step = t.active_lane_step[LANE_DURATION];
+		t.prev_note = t.active_note;
+		t.prev_note2 = t.active_note2;
 		stepkeeper = timekeeper;
-		setActiveNote(); //update pitch
-		gate_active = false;
-		digitalWrite(GATE_PIN, HIGH);
+		setActiveNote(t); //update pitch
+		t.gate_active = false;
+		digitalWrite(track_gate_pins[t.output], HIGH);
 
 	} else {
 		//make each note as long as the button was held down for
-		int8_t steps_elapsed = current_step - step_recording_initiated_step;
+		int16_t steps_elapsed = t.current_step - step_recording_initiated_step;
 		if (steps_elapsed < 0) {
-			steps_elapsed += active_sequence.sequence_length;
+			steps_elapsed += t.seq->sequence_length;
 		}
-		//active_sequence.duration_matrix[step_recording_initiated_step] = min(1 + 100 * , 400);
-		uint16_t recorded_step_duration = timekeeper - stepkeeper + (steps_elapsed * calculated_step_length);
+		//t.seq->steps[step_recording_initiated_step].duration = min(1 + 100 * , 400);
+		uint16_t recorded_step_duration = timekeeper - stepkeeper + (steps_elapsed * t.calculated_step_length);
 
-		active_sequence.duration_matrix[step_recording_initiated_step] = min(400, recorded_step_duration * 100 / calculated_step_length);
-		digitalWrite(GATE_PIN, LOW);
+		setField(t, FIELD_DURATION, step_recording_duration_step, min(400, recorded_step_duration * 100 / t.calculated_step_length));
+		digitalWrite(track_gate_pins[t.output], LOW);
 	}
 	step_recording_mode = state;
 }
 
 void Sequencer::incrementClock(int steps) { //manually adjsut clock from front panel aka "jog"
-	clock_step += steps;
-	if (clock_step >= active_sequence.sequence_length) {
-		clock_step = 0;
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		track &t = tracks[i];
+		t.clock_step += steps;
+		if (t.clock_step >= t.seq->sequence_length) {
+			t.clock_step = 0;
+		}
 	}
 }
 
 void Sequencer::setCVMode(uint8_t mode){
-	active_sequence.cv_mode = mode;
+	editField(editTrack(), FIELD_CV_MODE, 0, mode);
 }
 
 uint8_t Sequencer::getCvMode(){
-	return active_sequence.cv_mode;
+	return editTrack().seq->cv_mode;
 }
 
 bool Sequencer::toggleMutateOnReset(){
 	mutate_on_reset = !mutate_on_reset;
 	calibrationVar->writeMutateOnReset(mutate_on_reset);
 	return mutate_on_reset;
-}
\ No newline at end of file
+}
+
+uint8_t Sequencer::cycleSwitchQuantize(){
+	switch_quantize = (switch_quantize + 1) % SWITCH_MODES;
+	calibrationVar->writeSwitchQuantize(switch_quantize);
+	return switch_quantize;
+}
+
+uint8_t Sequencer::getSwitchQuantize(){
+	return switch_quantize;
+}
+
+void Sequencer::queueSequenceSwitch(){ //timeForNextSequence fires on the next boundary
+	switch_queued = true;
+}
+
+void Sequencer::cancelSequenceSwitch(){
+	switch_queued = false;
+}
+
+bool Sequencer::isRunning(){ //playing, or clocked from outside within the last 2 seconds
+	return play_active || timekeeper < 2000;
+}
+
+bool Sequencer::onSwitchBoundary(track& t){
+	switch (switch_quantize) {
+		case SWITCH_BAR: return t.clock_step % 16 == 0;
+		case SWITCH_4_BARS: return t.clock_step % 16 == 0 && phrase_bar == 0;
+		case SWITCH_PATTERN: return t.clock_step == 0;
+	}
+	return true;
+}
+
+void Sequencer::setArpKey(uint8_t key, bool held){ //called from the button events, the step engine only reads the result
+	uint16_t bit = 1 << key;
+	if (held == ((arp_keys & bit) != 0)) return;
+	if (held) {
+		if (!arp_keys) { //first key of a new chord starts the pattern from its beginning
+			arp_position = -1;
+			arp_direction = 1;
+		}
+		arp_keys |= bit;
+		arp_order[arp_key_count++] = key;
+	} else {
+		arp_keys &= ~bit;
+		uint8_t i = 0;
+		while (arp_order[i] != key) i++;
+		arp_key_count--;
+		for (; i < arp_key_count; i++) {
+			arp_order[i] = arp_order[i + 1];
+		}
+	}
+}
+
+int Sequencer::incrementArpMode(int amount){
+	arp_mode = getMinMaxParam(arp_mode, amount, 0, ARP_MODES - 1);
+	return arp_mode;
+}
+
+int Sequencer::incrementArpOctaves(int amount){
+	arp_octaves = getMinMaxParam(arp_octaves, amount, 1, ARP_MAX_OCTAVES);
+	return arp_octaves;
+}
+
+int8_t Sequencer::nextArpNote(track& t){ //bounded by the 16 keys, whatever is held
+	int8_t total = arp_key_count * arp_octaves;
+	switch (arp_mode) {
+		case ARP_DOWN:
+			arp_position = arp_position <= 0 ? total - 1 : arp_position - 1;
+			break;
+		case ARP_UP_DOWN:
+			arp_position += arp_direction;
+			if (arp_position >= total) {
+				arp_position = max(total - 2, 0);
+				arp_direction = -1;
+			} else if (arp_position < 0) {
+				arp_position = min(1, total - 1);
+				arp_direction = 1;
+			}
+			break;
+		case ARP_RANDOM:
+			arp_position = t.random.range(total);
+			break;
+		default:
+			arp_position = arp_position + 1 >= total ? 0 : arp_position + 1;
+	}
+	if (arp_position >= total) arp_position = 0; //keys let go since the last step
+
+	uint8_t index = arp_position % arp_key_count;
+	uint8_t key = arp_order[index];
+	if (arp_mode != ARP_AS_PLAYED) { //index-th held key from the bottom
+		uint16_t keys = arp_keys;
+		for (; index; index--) keys &= keys - 1;
+		key = __builtin_ctz(keys);
+	}
+	return scaleDegree(t, key) + (arp_position / arp_key_count) * 12;
+}
+
+int8_t Sequencer::scaleDegree(track& t, uint8_t degree){ //semitones above the root
+	uint8_t tones = __builtin_popcount(t.scale_tones & 0x0FFF);
+	uint8_t octave = degree / tones;
+	degree -= octave * tones;
+	uint8_t tone = 0;
+	while (true) {
+		if ((t.scale_tones >> tone) & 1) {
+			if (!degree) break;
+			degree--;
+		}
+		tone++;
+	}
+	return octave * 12 + tone;
+}
+
+void Sequencer::restartRandom(){
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		tracks[i].random.seed(tracks[i].seq->random_seed);
+	}
+}
+
+uint16_t Sequencer::reseedRandom(){ //pick a new seed, mixing in the time of the button press
+	track &t = editTrack();
+	t.random.seed(t.random.next() ^ (uint16_t)micros());
+	return t.seq->random_seed = t.random.getState(); //seed() never leaves a zero state
+}
+
+//TURING2 samples from the pitches the user entered on active steps. The pool is
+//kept in sync on each edit so engaging the effect needs no scan. Pitches written
+//by the effects themselves are not pooled, so the pattern doesn't collapse.
+void Sequencer::rebuildPitchPool(){
+	for (byte i = 0; i < TRACK_COUNT; i++) {
+		rebuildPitchPool(tracks[i]);
+	}
+}
+
+void Sequencer::rebuildPitchPool(track& t){
+	t.num_active_pitches = 0;
+	memset(t.pitch_pool_slot, -1, sizeof(t.pitch_pool_slot));
+	for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+		addToPitchPool(t, i);
+	}
+}
+
+void Sequencer::addToPitchPool(track& t, uint8_t step){
+	if (t.pitch_pool_slot[step] >= 0 || !pitchIsPlayable(t, step)) return;
+	t.pitch_pool_slot[step] = t.num_active_pitches;
+	t.active_pitches[t.num_active_pitches++] = t.seq->steps[step].pitch;
+}
+
+bool Sequencer::pitchIsPlayable(track& t, uint8_t step){ //an own-length pitch lane plays every slot regardless of gates
+	uint8_t length = t.seq->lane_length[LANE_PITCH];
+	if (length) return step < length;
+	return step < t.seq->sequence_length && t.seq->steps[step].gate;
+}
+
+void Sequencer::removeFromPitchPool(track& t, uint8_t step){
+	int8_t slot = t.pitch_pool_slot[step];
+	if (slot < 0) return;
+	t.pitch_pool_slot[step] = -1;
+	t.num_active_pitches--;
+	if (slot == t.num_active_pitches) return;
+
+	//move the last pitch into the freed slot and repoint the step that owns it
+	t.active_pitches[slot] = t.active_pitches[t.num_active_pitches];
+	for (byte i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+		if (t.pitch_pool_slot[i] == t.num_active_pitches) {
+			t.pitch_pool_slot[i] = slot;
+			break;
+		}
+	}
+}
+
+track& Sequencer::editTrack(){
+	return tracks[edit_track];
+}
+
+bool Sequencer::trackEnabled(track& t){
+	return t.seq->clock_division > 0;
+}
+
+bool Sequencer::hasCv2(track& t){ //the CV2 lane shares DAC channel 1 with the second track
+	return t.output == 0 && !trackEnabled(tracks[1]);
+}
+
+uint8_t Sequencer::selectNextTrack(){
+	edit_track = (edit_track + 1) % TRACK_COUNT;
+	return edit_track;
+}
+
+uint8_t Sequencer::getEditTrack(){
+	return edit_track;
+}
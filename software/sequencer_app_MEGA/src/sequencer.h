@@ -1,16 +1,73 @@
 #pragma once
 #include "calibrate.h"
 #include "dac.h"
+#include "prng.h"
+#include "journal.h"
+#include "song.h"
 #include <Arduino.h>
 
+const uint8_t SEQUENCE_MAX_LENGTH = 128; //8 bars
+
+//lanes that can run at their own length against the gate lane (step.gate, sequence_length)
+const uint8_t LANE_PITCH = 0; //pitch and octave
+const uint8_t LANE_DURATION = 1;
+const uint8_t LANE_CV = 2;
+const uint8_t LANE_COUNT = 3;
+
+//sequence settings a step can lock to its own value, bit positions in param_lock.mask
+const uint8_t LOCK_TRANSPOSE = 0;
+const uint8_t LOCK_GLIDE = 1; //glide_length
+const uint8_t LOCK_EFFECT = 2;
+const uint8_t LOCK_EFFECT_DEPTH = 3;
+const uint8_t LOCK_SWING = 4; //only read from the first track, like the sequence swing
+const uint8_t LOCK_PARAM_COUNT = 5;
+const uint8_t LOCK_SLOTS = 16; //steps per track that can hold locks
+const uint16_t LOCK_NONE = 0x100; //lock value of a parameter that isn't locked
+
+//modulation matrix: cv inputs routed to sequence settings, applied on top of the active step's locks when it starts
+const uint8_t MOD_OFF = 0; //source of an unused route, the cv inputs are sources 1..MOD_INPUTS
+const uint8_t MOD_INPUTS = 2;
+const uint8_t MOD_CV2 = LOCK_PARAM_COUNT; //destinations are the LOCK_ parameters and an offset of the cv lane
+const uint8_t MOD_DESTINATIONS = LOCK_PARAM_COUNT + 1;
+const uint8_t MOD_ROUTES = 4;
+const int8_t MOD_MAX_AMOUNT = 100;
+
+struct mod_route {
+	uint8_t source = MOD_OFF;
+	uint8_t destination = LOCK_TRANSPOSE;
+	int8_t amount = 0; //change of the destination at full scale input, in its own units
+};
+
+//motion lanes sample the cv2 knob several times per step while recording
+const uint8_t MOTION_SUBSTEPS = 8;
+const uint8_t MOTION_STEPS = 64; //motion is only recorded on the first 4 bars of the cv lane
+const int8_t MOTION_NONE = -128; //key of a step without recorded motion
+
+struct motion_step {
+	int8_t key = MOTION_NONE; //first sample, in the units of step.cv
+	uint8_t deltas[MOTION_SUBSTEPS / 2]; //the following samples as signed 4-bit steps from the one before, low nibble first. the last nibble is spare
+};
+
+struct param_lock {
+	uint8_t mask; //bit per LOCK_ parameter this step overrides
+	uint8_t values[LOCK_PARAM_COUNT];
+};
+
+//one step of the note lanes packed into 4 bytes, so 128 steps take the SRAM 64 did as separate arrays.
+//fields that fill a byte are kept on byte boundaries
+struct step_data {
+	int32_t pitch : 5; //-12..12
+	uint32_t gate : 1; //step on
+	uint32_t glide : 1;
+	uint32_t effect : 1; //recorded mutate
+	int32_t cv : 8; //0..100, or -24..24 / 12..60 depending on cv_mode
+	uint32_t duration : 9; //percent of the step length, up to 400
+	int32_t octave : 4; //-4..4
+};
+
 struct sequence {
-	int8_t pitch_matrix[64];
-	int8_t octave_matrix[64];
-	uint16_t duration_matrix[64];
-	int8_t cv_matrix[64];
-    bool step_matrix[64] = { 1,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 };
-	bool glide_matrix[64];
-    bool effect_matrix[64];
+	step_data steps[SEQUENCE_MAX_LENGTH];
+    uint8_t trig_matrix[SEQUENCE_MAX_LENGTH]; //condition in the high nibble, probability in the low nibble (0 = always, 15 = 1/16)
 
 	uint8_t glide_length = 50;
 	uint8_t sequence_length = 16;
@@ -23,9 +80,85 @@ struct sequence {
     uint8_t sequence_tempo = 120;
 
     int8_t transpose = 24;
-    int8_t song_next_seq = 0;
-    int8_t song_loops = 0;
     int8_t cv_mode = 0;
+
+    uint16_t random_seed = PRNG_DEFAULT_SEED; //seed for random/turing effects, so generative patterns replay identically
+    uint8_t clock_division = 1; //base clock ticks per step, 0 = track off
+    uint8_t lane_length[LANE_COUNT] = { 0, 0, 0 }; //0 = lane follows the gate lane
+    uint8_t lock_steps[SEQUENCE_MAX_LENGTH / 8] = { 0 }; //bit per step with locks. locks holds their entries in step order
+    uint8_t lock_count = 0;
+    param_lock locks[LOCK_SLOTS];
+    motion_step motion[MOTION_STEPS]; //follows the cv lane, 5 bytes per step
+};
+
+//where a pattern picked by hand takes over while the sequencer runs
+const uint8_t SWITCH_NOW = 0;
+const uint8_t SWITCH_BAR = 1; //next bar line of the first track
+const uint8_t SWITCH_4_BARS = 2;
+const uint8_t SWITCH_PATTERN = 3; //end of the first track's pattern
+const uint8_t SWITCH_MODES = 4;
+
+//arpeggiator orders, playing the held step keys as scale degrees
+const uint8_t ARP_UP = 0;
+const uint8_t ARP_DOWN = 1;
+const uint8_t ARP_UP_DOWN = 2;
+const uint8_t ARP_RANDOM = 3;
+const uint8_t ARP_AS_PLAYED = 4;
+const uint8_t ARP_MODES = 5;
+const uint8_t ARP_MAX_OCTAVES = 4;
+
+const uint8_t TRACK_COUNT = 2; //one track per DAC channel, track 0 also owns the CV2 lane while track 1 is off
+
+//playback state of one track. kept to the narrowest types since every track costs SRAM on the Mega
+struct track {
+    sequence *seq; //playing bank, the other one takes the next song pattern while this plays
+
+    int8_t active_pitches[SEQUENCE_MAX_LENGTH]; //pool of pitches on active steps, sampled by TURING2
+    int8_t pitch_pool_slot[SEQUENCE_MAX_LENGTH]; //index of each step's pitch in active_pitches, -1 if not in the pool
+    uint8_t num_active_pitches = 0;
+
+    uint8_t output = 0; //DAC channel and gate output
+    int16_t clock_step = -1;
+    int16_t current_step = -1;
+    int16_t active_step = -1;
+    uint8_t prev_sequence_length = 16;
+    uint8_t repeat_step_origin = 0;
+    uint8_t division_counter = 0; //base clock ticks elapsed since this track's step started
+    int16_t lane_step[LANE_COUNT] = { -1, -1, -1 }; //playheads of the lanes with their own length
+    uint8_t active_lane_step[LANE_COUNT] = { 0, 0, 0 }; //where each lane was when active_step was latched
+    uint8_t loop_count = 0; //passes of the gate lane since reset, modulo TRIG_LOOP_CYCLE
+    bool first_loop = true;
+    bool step_fires = false; //current step is on and passed its condition and probability
+    uint16_t scale_tones = 0; //bit per semitone of seq.scale, bit 12 is the octave
+    param_lock lock = { 0 }; //locks of the active step, mask is 0 when it has none. modulated settings are locked here too
+    int8_t cv2_offset = 0; //modulation of the cv lane while the active step plays
+    uint8_t motion_substep = 0; //last motion sample played or recorded in the active step
+
+    bool step_advanced = false; //track moved to a new step on the last base clock tick
+    bool gate_active = false;
+    bool effect_mode = false;
+    bool turing_mode = false;
+    bool note_reached = false;
+    int8_t random_octave = 0;
+    int8_t arp_note = -1; //semitones above the root played by the arpeggiator this step, -1 = the pitch lane plays
+
+    int prev_note = 0;
+    int prev_note2 = 0;
+    int active_note = 0;
+    int active_note2 = 0; //for cv2
+    int glide_time = 0;
+    unsigned int calculated_step_length = 10;
+    unsigned int calculated_roll = 0;
+    unsigned int calculated_stutter = 0;
+
+    double current_note_value = 0;
+    double current_note_value2 = 0; // for cv2 in quantized mode
+    double lfo_target = 0;
+    double lfo_prev = 0;
+    double lfo_time = 0;
+    uint8_t lfo_steps = 0;
+
+    Prng random; //drives random/turing effects, restarted from seq.random_seed
 };
 
 class Sequencer{
@@ -51,9 +184,10 @@ class Sequencer{
         int incrementEffect(int amount);
         int incrementEffectDepth(int amount);
         int incrementGlide(int amount);
-        int incrementSongNextSeq(int incrementAmount);
-        int incrementSongLoops(int incrementAmount);
-        int getSongNextSeq();
+        Song& getSong();
+        bool songOnLastLoop();
+        sequence * getShadowSequence(uint8_t track_index);
+        void swapSequences();
         
 
         void onPlayButton();
@@ -75,7 +209,6 @@ class Sequencer{
         int getCv();
 
 
-        bool *getStepMatrix();
         void setStepMatrix();
 
         int getSelectedStep();
@@ -84,9 +217,9 @@ class Sequencer{
         void onMutateButton(bool state);
         
         void setTempoFromSequence();
-        void loadScale(uint8_t scale);
         void onBarSelect(byte bar);
         void clearSequence();
+        void clearTrack(uint8_t track_index);
         void setActiveNote();
         void memoizeSequenceLength();
         void pickupPositionInNewSequence();
@@ -99,10 +232,47 @@ class Sequencer{
         void setAudition(bool audition);
         void setCVMode(uint8_t mode);
         bool toggleMutateOnReset();
+        uint8_t cycleSwitchQuantize();
+        uint8_t getSwitchQuantize();
+        void queueSequenceSwitch();
+        void cancelSequenceSwitch();
+        bool isRunning();
+        void setArpKey(uint8_t key, bool held);
+        int incrementArpMode(int amount);
+        int incrementArpOctaves(int amount);
+        void restartRandom();
+        void rebuildPitchPool();
+        uint16_t reseedRandom();
+
+        uint8_t selectNextTrack();
+        uint8_t getEditTrack();
+        int incrementDivision(int amount);
+        int incrementLaneLength(uint8_t lane, int amount);
+        int incrementProbability(int amount);
+        int incrementCondition(int amount);
+        void setFill(bool state);
+        void fillEuclid(uint8_t first_step, uint8_t steps, uint8_t hits, uint8_t rotation);
+        void rotateSequence(int amount);
+        void reverseSequence();
+        void invertPitches();
+        void transposeInScale(int degrees);
+        void foldOctaves();
+        uint8_t undo();
+        uint8_t redo();
+        void clearHistory();
+        int incrementLock(uint8_t step, uint8_t param, int amount);
+        bool getLocked(uint8_t step, uint8_t param);
+        void setMotionInput(int newVal);
+        void setModInput(uint8_t input, int analogValue);
+        int incrementModSource(uint8_t route, int amount);
+        int incrementModDestination(uint8_t route, int amount);
+        int incrementModAmount(uint8_t route, int amount);
+        uint8_t getModSource(uint8_t route);
+        void writeModRoutes();
+        sequence * getTrackSequence(uint8_t track_index);
 
         uint8_t getCvMode();
         int8_t getCv2DisplayValue(int analogvalue);
-        //void getSongLoops(int loops);
 
         sequence& getActiveSequence();
         sequence * getSequence();
@@ -111,27 +281,78 @@ class Sequencer{
         int getMinMaxParam(int param, int increment_amount, int min, int max);
         uint8_t setMinMaxParamUnsigned(uint8_t& param, int8_t increment_amount, uint8_t min, uint8_t max);
         int8_t setMinMaxParam(int8_t& param, int8_t increment_amount, int8_t min, int8_t max);
-        void setEffectMode(bool state);
-        void updateGlide();
-        void updateGate();
-        uint8_t editedStep();
-        void setPitchOutput(uint8_t step);
-        void setCv2Output(uint8_t step);
-        int8_t quantizePitch(int8_t pitch);
+        track& editTrack();
+        bool trackEnabled(track& t);
+        bool hasCv2(track& t);
+        void advanceTrack(track& t);
+        void setActiveNote(track& t);
+        void setGate(track& t, bool state);
+        void loadScale(track& t);
+        bool scaleHasTone(track& t, int8_t pitch);
+        int8_t scaleCorrection(track& t, uint8_t pitch_class);
+        uint8_t laneLength(track& t, uint8_t lane);
+        int pivotNote(track& t);
+        bool beginNoteTransform(track& t);
+        void setNote(track& t, uint8_t step, int note, bool journaled);
+        void rotateTrack(track& t, int amount);
+        void reverseTrack(track& t);
+        void reverseField(sequence& seq, uint8_t field, uint8_t first, uint8_t last);
+        void rotateField(sequence& seq, uint8_t field, uint8_t length, int amount);
+        uint16_t readField(sequence& seq, uint8_t field, uint8_t step);
+        void writeField(sequence& seq, uint8_t field, uint8_t step, uint16_t value);
+        void setField(track& t, uint8_t field, uint8_t step, uint16_t value);
+        void editField(track& t, uint8_t field, uint8_t step, uint16_t value);
+        void applyJournalEntry(const journal_entry& entry, bool undo);
+        sequence * shadowBank(uint8_t track_index);
+        void snapshotTrack(uint8_t track_index, uint8_t field, uint8_t argument);
+        void restoreTrack(uint8_t track_index);
+        bool stepHasLocks(sequence& seq, uint8_t step);
+        uint8_t lockSlot(sequence& seq, uint8_t step);
+        void writeLock(sequence& seq, uint8_t param, uint8_t step, uint16_t value);
+        void moveLocks(sequence& seq, int amount, bool reverse);
+        void resolveLocks(track& t);
+        void resolveModulation(track& t);
+        int8_t offsetCv2(track& t, int8_t cv);
+        uint8_t stepEffectDepth(uint8_t effect, uint8_t depth, int amount);
+        void refreshAfterHistory();
+        void setEffectMode(track& t, bool state);
+        void updateGlide(track& t);
+        void updateGate(track& t);
+        uint8_t editedStep(uint8_t lane);
+        void setPitchOutput(track& t, uint8_t step, uint8_t *lanes);
+        void setCv2Output(track& t, uint8_t *lanes);
+        void renderCv2(track& t, int8_t cv, uint8_t pitch_step);
+        void updateMotion(track& t);
+        int8_t motionSample(motion_step& motion, uint8_t substep);
+        void writeMotion(motion_step& motion, uint8_t substep, int8_t value);
+        int8_t quantizePitch(track& t, int8_t pitch);
+        int8_t randomSign(track& t);
         uint8_t getCv2Value(uint8_t step);
         void initializeSerializedSequence();
-        void generateTuringPitches();
+        void generateTuringPitches(track& t);
+        void rebuildPitchPool(track& t);
+        void addToPitchPool(track& t, uint8_t step);
+        void removeFromPitchPool(track& t, uint8_t step);
         void updateSwingCalc();
-        void updateGlideCalc();
-        void updateRollCalc();
-        void updateStutterCalc();
-        int getGlideKeeper(int step);
+        void updateGlideCalc(track& t);
+        void updateRollCalc(track& t);
+        void updateStutterCalc(track& t);
+        int getStepLength(track& t);
+        int getGlideKeeper(track& t, int step);
         void onClock();
         static void onClockIn();
         static void onResetIn();
-        void setLfoTarget();
-        void updateLfo();
-        void runStepEffects();
+        void setLfoTarget(track& t);
+        void updateLfo(track& t);
+        void runStepEffects(track& t);
+        void advanceLanes(track& t);
+        bool stepFires(track& t);
+        bool onSwitchBoundary(track& t);
+        int8_t nextArpNote(track& t);
+        int8_t scaleDegree(track& t, uint8_t degree);
+        void latchActiveStep(track& t, uint8_t step);
+        void decideStep(track& t);
+        bool pitchIsPlayable(track& t, uint8_t step);
         void onMutate(bool state);
 
 };
\ No newline at end of file
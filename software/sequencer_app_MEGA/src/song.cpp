@@ -0,0 +1,65 @@
+#include "song.h"
+
+void Song::clear(){
+    for (uint8_t i = 0; i < SONG_LENGTH; i++) {
+        entries[i] = song_entry();
+    }
+    stop();
+}
+
+uint8_t Song::getLength(){
+    uint8_t length = 0;
+    while (length < SONG_LENGTH && entries[length].patch) length++;
+    return length;
+}
+
+song_entry& Song::entry(uint8_t index){
+    return entries[index < SONG_LENGTH ? index : SONG_LENGTH - 1];
+}
+
+void Song::start(uint8_t index){
+    position = index;
+    playing = true;
+    resolveNext();
+}
+
+void Song::stop(){
+    playing = false;
+    position = 0;
+    next = 0;
+}
+
+int8_t Song::getTranspose(){
+    return playing ? entries[position].transpose : 0;
+}
+
+int Song::incrementPatch(uint8_t index, int amount){
+    song_entry &e = entry(index);
+    e.patch = increment(e.patch, amount, 0, SONG_MAX_PATCH);
+    if (playing) resolveNext(); //the end of the song may have moved
+    return e.patch;
+}
+
+int Song::incrementRepeats(uint8_t index, int amount){
+    song_entry &e = entry(index);
+    e.repeats = increment(e.repeats, amount, 1, SONG_MAX_REPEATS);
+    return e.repeats;
+}
+
+int Song::incrementTranspose(uint8_t index, int amount){
+    song_entry &e = entry(index);
+    e.transpose = increment(e.transpose, amount, -SONG_MAX_TRANSPOSE, SONG_MAX_TRANSPOSE);
+    return e.transpose;
+}
+
+int Song::increment(int value, int amount, int min, int max){
+    value += amount;
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+void Song::resolveNext(){
+    next = position + 1;
+    if (next >= getLength()) next = 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+/**
+ * @file song.h
+ * @brief Song arrangement: an ordered list of patches played in turn.
+ *
+ * Each entry names a patch, how many loops of the first track it plays for
+ * and a transpose added to both tracks while it plays. The list ends at the
+ * first entry without a patch. The song is stored in its own flash file, so
+ * an arrangement can be reordered without touching the patches in it.
+ *
+ * The song keeps the list and the playback position. The entry that follows
+ * the playing one is resolved as soon as playback moves, so it is known a
+ * whole pattern ahead of the switch. The sequencer counts the loops and the
+ * ui loads the patches.
+ */
+
+#include <stdint.h>
+
+// 64 entries = 192 bytes of SRAM.
+const uint8_t SONG_LENGTH = 64;
+const uint8_t SONG_MAX_PATCH = 99;
+const uint8_t SONG_MAX_REPEATS = 99;
+const int8_t SONG_MAX_TRANSPOSE = 24;
+
+struct song_entry {
+    uint8_t patch = 0;     // 0 ends the song
+    uint8_t repeats = 1;   // loops of the first track
+    int8_t transpose = 0;  // semitones
+};
+
+class Song {
+public:
+    /**
+     * @brief Empty the list and stop playback.
+     */
+    void clear();
+
+    /**
+     * @brief Number of entries before the first one without a patch.
+     */
+    uint8_t getLength();
+
+    song_entry& entry(uint8_t index);
+
+    /**
+     * @brief Play from an entry on, and resolve the one that follows it.
+     */
+    void start(uint8_t index);
+    void stop();
+
+    bool isPlaying() { return playing; }
+    uint8_t getPosition() { return position; }
+
+    /**
+     * @brief Entry to play once the current one has done its repeats,
+     * wrapping around to the first entry at the end of the song.
+     */
+    uint8_t getNext() { return next; }
+
+    /**
+     * @brief Transpose of the playing entry, 0 while the song is stopped.
+     */
+    int8_t getTranspose();
+
+    /**
+     * @brief Edit a field of an entry. Setting the patch to 0 ends the song there.
+     * @return The new value.
+     */
+    int incrementPatch(uint8_t index, int amount);
+    int incrementRepeats(uint8_t index, int amount);
+    int incrementTranspose(uint8_t index, int amount);
+
+private:
+    song_entry entries[SONG_LENGTH];
+    uint8_t position = 0;
+    uint8_t next = 0;
+    bool playing = false;
+
+    int increment(int value, int amount, int min, int max);
+    void resolveNext();
+};
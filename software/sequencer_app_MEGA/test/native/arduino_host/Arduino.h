@@ -0,0 +1,68 @@
+#pragma once
+/**
+ * @file Arduino.h
+ * @brief The parts of the Arduino core the sequencer engine uses, for the
+ * native test build.
+ *
+ * Pins are plain arrays and time only moves when a test moves it, see host.h.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "host.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define DEFAULT 1
+#define EXTERNAL 0
+
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+
+#define _BV(b) (1 << (b))
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define digitalPinToInterrupt(p) (p)
+#define digitalPinToPort(p) ((uint8_t)(p))
+#define digitalPinToBitMask(p) ((uint8_t)(1 << ((p) & 7)))
+#define portOutputRegister(p) (&PORTA)
+#define portInputRegister(p) (&PINA)
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+void shiftOut(uint8_t data_pin, uint8_t clock_pin, uint8_t bit_order, uint8_t value);
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+char *itoa(int value, char *str, int base);
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+const uint16_t HOST_EEPROM_SIZE = 4096; //ATmega2560
+
+struct EEPROMClass {
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value);
+};
+
+extern EEPROMClass EEPROM;
+extern uint8_t host_eeprom[HOST_EEPROM_SIZE]; //erased (0xFF) by hostReset, like a new chip
@@ -0,0 +1,54 @@
+#pragma once
+/**
+ * @file SerialFlash.h
+ * @brief In-memory stand-in for https://github.com/PaulStoffregen/SerialFlash.
+ *
+ * Files live in RAM and every call that would reach the chip is counted, so a
+ * test can tell whether some code path touched the flash at all.
+ */
+
+#include <stdint.h>
+
+const uint8_t HOST_FLASH_FILES = 40;
+const uint8_t HOST_FLASH_NAME = 16;
+
+class SerialFlashFile {
+public:
+    SerialFlashFile() : index(-1), offset(0) {}
+    operator bool();
+    uint32_t read(void *buf, uint32_t rdlen);
+    uint32_t write(const void *buf, uint32_t wrlen);
+    void seek(uint32_t n) { offset = n; }
+    uint32_t position() { return offset; }
+    uint32_t size();
+    void close() { index = -1; }
+    void erase();
+
+private:
+    friend class SerialFlashChip;
+    int index;
+    uint32_t offset;
+};
+
+class SerialFlashChip {
+public:
+    bool begin(uint8_t pin);
+    bool ready();
+    bool exists(const char *filename);
+    SerialFlashFile open(const char *filename);
+    bool create(const char *filename, uint32_t length);
+    bool createErasable(const char *filename, uint32_t length);
+    void eraseAll();
+};
+
+extern SerialFlashChip SerialFlash;
+
+//chip accesses since hostReset, or since a test cleared them
+struct host_flash_counters {
+    uint32_t opens;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t lookups; //exists()
+};
+extern host_flash_counters host_flash;
+extern bool host_flash_busy; //ready() returns false, as while an erase runs
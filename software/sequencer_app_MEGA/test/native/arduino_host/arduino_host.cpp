@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <SerialFlash.h>
+#include <stdio.h>
+
+volatile uint8_t PINA, PINB, PINC, PIND, PINE, PINF, PING, PINK, PINL;
+volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, PORTK, PORTL;
+volatile uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF, DDRG, DDRK, DDRL;
+volatile uint8_t ADMUX, ADCSRA, ADCSRB, DIDR0, SREG;
+volatile uint16_t ADC;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2, OCR0B, TIMSK0;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2;
+
+uint32_t host_micros = 0;
+uint8_t host_pins[HOST_PINS];
+uint16_t host_dac_value[2];
+uint16_t host_dac_writes[2];
+uint8_t dac_high_byte;
+bool dac_high_sent = false;
+
+EEPROMClass EEPROM;
+uint8_t host_eeprom[HOST_EEPROM_SIZE];
+
+SerialFlashChip SerialFlash;
+host_flash_counters host_flash;
+bool host_flash_busy = false;
+
+struct host_file {
+    bool used;
+    char name[HOST_FLASH_NAME];
+    uint32_t length;
+    uint8_t *data;
+};
+host_file flash_files[HOST_FLASH_FILES];
+
+void hostReset(){
+    host_micros = 0;
+    memset(host_pins, HIGH, sizeof(host_pins));
+    PINA = PINB = PINC = PIND = PINE = PINF = PING = PINK = PINL = 0xFF;
+    host_dac_value[0] = host_dac_value[1] = 0;
+    host_dac_writes[0] = host_dac_writes[1] = 0;
+    dac_high_sent = false;
+    memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+    SerialFlash.eraseAll();
+    host_flash = host_flash_counters();
+    host_flash_busy = false;
+}
+
+void hostAdvanceMillis(uint32_t ms){
+    host_micros += ms * 1000;
+}
+
+void pinMode(uint8_t, uint8_t){}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+    if (pin < HOST_PINS) host_pins[pin] = value;
+}
+
+int digitalRead(uint8_t pin){
+    return pin < HOST_PINS ? host_pins[pin] : HIGH;
+}
+
+int analogRead(uint8_t){
+    return 0;
+}
+
+void analogReference(uint8_t){}
+
+void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t value){
+    if (!dac_high_sent) {
+        dac_high_byte = value;
+        dac_high_sent = true;
+        return;
+    }
+    host_dac_value[dac_high_byte >> 7] = (dac_high_byte & 0x0F) << 8 | value;
+    host_dac_writes[dac_high_byte >> 7]++;
+    dac_high_sent = false;
+}
+
+void attachInterrupt(uint8_t, void (*)(), int){}
+
+unsigned long millis(){
+    return host_micros / 1000;
+}
+
+unsigned long micros(){
+    return host_micros;
+}
+
+void delay(unsigned long ms){
+    hostAdvanceMillis(ms);
+}
+
+void delayMicroseconds(unsigned int us){
+    host_micros += us;
+}
+
+char *itoa(int value, char *str, int base){
+    if (base == 16) {
+        sprintf(str, "%x", value);
+    } else {
+        sprintf(str, "%d", value);
+    }
+    return str;
+}
+
+uint8_t EEPROMClass::read(int address){
+    return host_eeprom[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value){
+    host_eeprom[address] = value;
+}
+
+void EEPROMClass::update(int address, uint8_t value){
+    host_eeprom[address] = value;
+}
+
+static int findFile(const char *filename){
+    for (int i = 0; i < HOST_FLASH_FILES; i++) {
+        if (flash_files[i].used && strcmp(flash_files[i].name, filename) == 0) return i;
+    }
+    return -1;
+}
+
+bool SerialFlashChip::begin(uint8_t){
+    return true;
+}
+
+bool SerialFlashChip::ready(){
+    return !host_flash_busy;
+}
+
+bool SerialFlashChip::exists(const char *filename){
+    host_flash.lookups++;
+    return findFile(filename) >= 0;
+}
+
+SerialFlashFile SerialFlashChip::open(const char *filename){
+    host_flash.opens++;
+    SerialFlashFile f;
+    f.index = findFile(filename);
+    return f;
+}
+
+bool SerialFlashChip::create(const char *filename, uint32_t length){
+    if (findFile(filename) >= 0 || strlen(filename) >= HOST_FLASH_NAME) return false;
+    for (int i = 0; i < HOST_FLASH_FILES; i++) {
+        host_file &file = flash_files[i];
+        if (file.used) continue;
+        file.used = true;
+        strcpy(file.name, filename);
+        file.length = length;
+        file.data = (uint8_t *)malloc(length);
+        memset(file.data, 0xFF, length);
+        return true;
+    }
+    return false;
+}
+
+bool SerialFlashChip::createErasable(const char *filename, uint32_t length){
+    return create(filename, length);
+}
+
+void SerialFlashChip::eraseAll(){
+    for (int i = 0; i < HOST_FLASH_FILES; i++) {
+        free(flash_files[i].data);
+        flash_files[i] = host_file();
+    }
+}
+
+SerialFlashFile::operator bool(){
+    return index >= 0;
+}
+
+uint32_t SerialFlashFile::size(){
+    return index >= 0 ? flash_files[index].length : 0;
+}
+
+uint32_t SerialFlashFile::read(void *buf, uint32_t rdlen){
+    if (index < 0) return 0;
+    host_flash.reads++;
+    host_file &file = flash_files[index];
+    if (offset >= file.length) return 0;
+    if (rdlen > file.length - offset) rdlen = file.length - offset;
+    memcpy(buf, file.data + offset, rdlen);
+    offset += rdlen;
+    return rdlen;
+}
+
+uint32_t SerialFlashFile::write(const void *buf, uint32_t wrlen){
+    if (index < 0) return 0;
+    host_flash.writes++;
+    host_file &file = flash_files[index];
+    if (offset >= file.length) return 0;
+    if (wrlen > file.length - offset) wrlen = file.length - offset;
+    const uint8_t *bytes = (const uint8_t *)buf;
+    for (uint32_t i = 0; i < wrlen; i++) {
+        file.data[offset + i] &= bytes[i]; //programming only clears bits
+    }
+    offset += wrlen;
+    return wrlen;
+}
+
+void SerialFlashFile::erase(){
+    if (index < 0) return;
+    host_flash.writes++;
+    memset(flash_files[index].data, 0xFF, flash_files[index].length);
+}
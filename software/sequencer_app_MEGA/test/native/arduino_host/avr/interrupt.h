@@ -0,0 +1,6 @@
+#pragma once
+//interrupt handlers become plain functions a test can call
+#define ISR(vector, ...) extern "C" void vector(void)
+#define ISR_NOBLOCK
+#define cli()
+#define sei()
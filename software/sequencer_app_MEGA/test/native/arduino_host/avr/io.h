@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+//I/O registers the sources touch, as plain variables. inputs rest HIGH
+extern volatile uint8_t PINA, PINB, PINC, PIND, PINE, PINF, PING, PINK, PINL;
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, PORTK, PORTL;
+extern volatile uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF, DDRG, DDRK, DDRL;
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB, DIDR0, SREG;
+extern volatile uint16_t ADC;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TIMSK2, OCR0B, TIMSK0;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2;
+
+#define REFS0 6
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define MUX5 3
+#define WGM21 1
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define OCIE2A 1
+#define OCIE0B 2
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
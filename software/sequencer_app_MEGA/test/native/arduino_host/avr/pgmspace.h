@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+//flash and RAM are one address space on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_byte_near(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(p))
+#define pgm_read_word_near(p) (*(const uint16_t *)(p))
+#define strcpy_P strcpy
+#define memcpy_P memcpy
@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+
+//same interface as https://github.com/pfeerick/elapsedMillis, on the host clock
+class elapsedMillis {
+public:
+    elapsedMillis() { start = millis(); }
+    elapsedMillis(unsigned long val) { start = millis() - val; }
+    operator unsigned long() const { return millis() - start; }
+    elapsedMillis & operator = (unsigned long val) { start = millis() - val; return *this; }
+    elapsedMillis & operator -= (unsigned long val) { start += val; return *this; }
+    elapsedMillis & operator += (unsigned long val) { start -= val; return *this; }
+private:
+    unsigned long start;
+};
+
+class elapsedMicros {
+public:
+    elapsedMicros() { start = micros(); }
+    elapsedMicros(unsigned long val) { start = micros() - val; }
+    operator unsigned long() const { return micros() - start; }
+    elapsedMicros & operator = (unsigned long val) { start = micros() - val; return *this; }
+    elapsedMicros & operator -= (unsigned long val) { start += val; return *this; }
+    elapsedMicros & operator += (unsigned long val) { start -= val; return *this; }
+private:
+    unsigned long start;
+};
@@ -0,0 +1,24 @@
+#pragma once
+/**
+ * @file host.h
+ * @brief What the tests see of the fake Arduino core: the clock, the pins and
+ * the last word sent to the DAC.
+ */
+
+#include <stdint.h>
+
+const uint8_t HOST_PINS = 70;
+
+extern uint32_t host_micros; // read by millis() and micros(), moved by delay() and the tests
+extern uint8_t host_pins[HOST_PINS]; // level of every pin, inputs rest HIGH as with their pullups
+
+// Dac::setOutput is the only user of shiftOut in the host build, two bytes per word
+extern uint16_t host_dac_value[2]; // last 12-bit value per DAC channel
+extern uint16_t host_dac_writes[2]; // words sent per DAC channel since hostReset
+
+/**
+ * @brief Put the pins, the clock and the fake EEPROM and flash back as they are at power up.
+ */
+void hostReset();
+
+void hostAdvanceMillis(uint32_t ms);
@@ -0,0 +1,5 @@
+#pragma once
+//nothing interrupts the host build, the block just runs once
+#define ATOMIC_BLOCK(type) for (uint8_t atomic_once = 1; atomic_once; atomic_once = 0)
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
@@ -0,0 +1,147 @@
+#include <unity.h>
+#include "analogFilter.h"
+#include "prng.h"
+
+//a knob setting one value per 42 counts, about the pitch knob's steps
+const int COUNTS_PER_LEVEL = 42;
+
+static int quantize(int analogValue) {
+    if (analogValue < 0) analogValue = 0;
+    if (analogValue > 1023) analogValue = 1023;
+    return analogValue / COUNTS_PER_LEVEL;
+}
+
+AnalogFilter filter;
+Prng noise;
+
+void setUp(void) {
+    filter = AnalogFilter();
+    noise.seed(PRNG_DEFAULT_SEED);
+}
+
+void tearDown(void) {}
+
+static int convert(int position) { //one conversion, within 2 counts of the knob
+    int value = position + noise.range(5) - 2;
+    return value < 0 ? 0 : value > 1023 ? 1023 : value;
+}
+
+static int readKnob(int position) { //one sum from the interrupt, then the filter
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < ADC_OVERSAMPLE; i++) {
+        sum += convert(position);
+    }
+    return filter.update(sum);
+}
+
+struct knob_reader {
+    int held;
+    uint16_t changes;
+    uint16_t raw_changes; //without the hysteresis
+    int raw;
+};
+
+static void readLevel(knob_reader &knob, int position) {
+    int analogValue = readKnob(position);
+    int level = quantize(analogValue);
+    if (level != knob.raw) knob.raw_changes++;
+    knob.raw = level;
+    int held = holdLevel(knob.held, level, analogValue, quantize);
+    if (held != knob.held) knob.changes++;
+    knob.held = held;
+}
+
+static knob_reader startReader(int position) {
+    int level = quantize(readKnob(position));
+    knob_reader knob = { level, 0, 0, level };
+    return knob;
+}
+
+void test_first_sum_is_taken_as_it_is(void) {
+    TEST_ASSERT_EQUAL_INT(512, filter.update(512 * ADC_OVERSAMPLE));
+    TEST_ASSERT_EQUAL_INT(512, filter.update(512 * ADC_OVERSAMPLE));
+}
+
+void test_full_scale_step_settles_without_overshoot(void) {
+    filter.update(0);
+    int last = 0;
+    uint8_t samples = 0;
+    int value;
+    do {
+        value = filter.update(1023 * ADC_OVERSAMPLE);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, value);
+        TEST_ASSERT_LESS_OR_EQUAL(1023, value);
+        last = value;
+    } while (value < 1020 && ++samples < 100);
+    TEST_ASSERT_LESS_THAN(40, samples); //100 ms at ~400 Hz
+}
+
+void test_filter_narrows_the_noise(void) {
+    readKnob(600);
+    int low = 1023;
+    int high = 0;
+    for (uint16_t i = 0; i < 2000; i++) {
+        int value = readKnob(600);
+        if (value < low) low = value;
+        if (value > high) high = value;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2, high - low); //conversions spread over 4 counts
+    TEST_ASSERT_INT_WITHIN(1, 600, (low + high) / 2);
+}
+
+void test_hold_level_needs_the_hysteresis_past_a_boundary(void) {
+    int boundary = 3 * COUNTS_PER_LEVEL;
+    TEST_ASSERT_EQUAL_INT(2, holdLevel(2, 3, boundary, quantize));
+    TEST_ASSERT_EQUAL_INT(2, holdLevel(2, 3, boundary + INPUT_HYSTERESIS - 1, quantize));
+    TEST_ASSERT_EQUAL_INT(3, holdLevel(2, 3, boundary + INPUT_HYSTERESIS, quantize));
+    TEST_ASSERT_EQUAL_INT(3, holdLevel(3, 2, boundary - 1, quantize));
+    TEST_ASSERT_EQUAL_INT(3, holdLevel(3, 2, boundary - INPUT_HYSTERESIS, quantize));
+    TEST_ASSERT_EQUAL_INT(2, holdLevel(3, 2, boundary - INPUT_HYSTERESIS - 1, quantize));
+    TEST_ASSERT_EQUAL_INT(11, holdLevel(0, 11, 500, quantize)); //a jump passes at once
+}
+
+void test_knob_resting_on_a_boundary_does_not_flicker(void) {
+    for (int boundary = COUNTS_PER_LEVEL; boundary < 1000; boundary += COUNTS_PER_LEVEL) {
+        knob_reader knob = startReader(boundary);
+        for (uint16_t i = 0; i < 1000; i++) {
+            readLevel(knob, boundary);
+        }
+        TEST_ASSERT_GREATER_THAN(0, knob.raw_changes); //the noise does cross the boundary
+        TEST_ASSERT_EQUAL_UINT16(0, knob.changes);
+    }
+}
+
+void test_slow_turn_changes_each_level_once(void) {
+    knob_reader knob = startReader(0);
+    TEST_ASSERT_EQUAL_INT(0, knob.held);
+    for (int position = 0; position <= 1023; position++) {
+        for (uint8_t i = 0; i < 4; i++) { //a count per 10 ms, a slow turn over the whole range
+            int before = knob.held;
+            readLevel(knob, position);
+            TEST_ASSERT_TRUE(knob.held == before || knob.held == before + 1);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(quantize(1023), knob.held);
+    TEST_ASSERT_EQUAL_UINT16(quantize(1023), knob.changes);
+
+    for (int position = 1023; position >= 0; position--) {
+        for (uint8_t i = 0; i < 4; i++) {
+            int before = knob.held;
+            readLevel(knob, position);
+            TEST_ASSERT_TRUE(knob.held == before || knob.held == before - 1);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(0, knob.held);
+    TEST_ASSERT_EQUAL_UINT16(2 * quantize(1023), knob.changes);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sum_is_taken_as_it_is);
+    RUN_TEST(test_full_scale_step_settles_without_overshoot);
+    RUN_TEST(test_filter_narrows_the_noise);
+    RUN_TEST(test_hold_level_needs_the_hysteresis_past_a_boundary);
+    RUN_TEST(test_knob_resting_on_a_boundary_does_not_flicker);
+    RUN_TEST(test_slow_turn_changes_each_level_once);
+    return UNITY_END();
+}
@@ -0,0 +1,109 @@
+#include <unity.h>
+#include "debounce.h"
+
+const uint8_t SCANS_TO_CHANGE = 7;
+
+VerticalDebounce keys;
+
+void setUp(void) {
+    keys.reset(0);
+}
+
+void tearDown(void) {}
+
+static uint32_t scan(uint32_t raw, uint8_t times) { //changes seen over the scans
+    uint32_t toggled = 0;
+    for (uint8_t i = 0; i < times; i++) {
+        toggled |= keys.update(raw);
+    }
+    return toggled;
+}
+
+void test_press_is_taken_on_the_seventh_scan(void) {
+    const uint32_t key = 1UL << 5;
+    for (uint8_t i = 1; i < SCANS_TO_CHANGE; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0, keys.update(key));
+        TEST_ASSERT_EQUAL_HEX32(0, keys.getState());
+    }
+    TEST_ASSERT_EQUAL_HEX32(key, keys.update(key));
+    TEST_ASSERT_EQUAL_HEX32(key, keys.getState());
+    TEST_ASSERT_EQUAL_HEX32(0, scan(key, 20)); //held, nothing more
+}
+
+void test_release_is_taken_on_the_seventh_scan(void) {
+    const uint32_t key = 1UL << 31;
+    keys.reset(key);
+    TEST_ASSERT_EQUAL_HEX32(0, scan(0, SCANS_TO_CHANGE - 1));
+    TEST_ASSERT_EQUAL_HEX32(key, keys.update(0));
+    TEST_ASSERT_EQUAL_HEX32(0, keys.getState());
+}
+
+void test_glitch_mid_count_starts_the_count_again(void) {
+    const uint32_t key = 1UL << 12;
+    TEST_ASSERT_EQUAL_HEX32(0, scan(key, 4));
+    TEST_ASSERT_EQUAL_HEX32(0, keys.update(0)); //bounced open for one scan
+    TEST_ASSERT_EQUAL_HEX32(0, scan(key, SCANS_TO_CHANGE - 1));
+    TEST_ASSERT_EQUAL_HEX32(key, keys.update(key));
+}
+
+void test_bouncing_key_never_changes(void) {
+    const uint32_t key = 1UL << 0;
+    for (uint8_t i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0, keys.update(i % SCANS_TO_CHANGE ? key : 0));
+    }
+    TEST_ASSERT_EQUAL_HEX32(0, keys.getState());
+}
+
+void test_two_keys_changing_on_the_same_scan(void) {
+    const uint32_t shift = 1UL << 16;
+    const uint32_t step = 1UL << 3;
+    TEST_ASSERT_EQUAL_HEX32(0, scan(shift | step, SCANS_TO_CHANGE - 1));
+    TEST_ASSERT_EQUAL_HEX32(shift | step, keys.update(shift | step));
+    TEST_ASSERT_EQUAL_HEX32(shift | step, keys.getState());
+
+    TEST_ASSERT_EQUAL_HEX32(0, scan(0, SCANS_TO_CHANGE - 1));
+    TEST_ASSERT_EQUAL_HEX32(shift | step, keys.update(0));
+    TEST_ASSERT_EQUAL_HEX32(0, keys.getState());
+}
+
+void test_keys_count_independently(void) {
+    const uint32_t first = 1UL << 8;
+    const uint32_t second = 1UL << 24;
+    TEST_ASSERT_EQUAL_HEX32(0, scan(first, 2));
+    TEST_ASSERT_EQUAL_HEX32(0, scan(first | second, SCANS_TO_CHANGE - 3));
+    TEST_ASSERT_EQUAL_HEX32(first, keys.update(first | second));
+    TEST_ASSERT_EQUAL_HEX32(0, keys.update(first | second));
+    TEST_ASSERT_EQUAL_HEX32(second, keys.update(first | second));
+    TEST_ASSERT_EQUAL_HEX32(first | second, keys.getState());
+}
+
+void test_glitch_on_one_key_leaves_the_other_counting(void) {
+    const uint32_t steady = 1UL << 1;
+    const uint32_t bouncy = 1UL << 2;
+    TEST_ASSERT_EQUAL_HEX32(0, scan(steady | bouncy, 3));
+    TEST_ASSERT_EQUAL_HEX32(0, keys.update(steady));
+    TEST_ASSERT_EQUAL_HEX32(0, scan(steady | bouncy, 2));
+    TEST_ASSERT_EQUAL_HEX32(steady, keys.update(steady | bouncy));
+    TEST_ASSERT_EQUAL_HEX32(0, scan(steady | bouncy, 3));
+    TEST_ASSERT_EQUAL_HEX32(bouncy, keys.update(steady | bouncy));
+}
+
+void test_reset_takes_held_keys_without_changes(void) {
+    const uint32_t held = 0x80000101;
+    keys.reset(held);
+    TEST_ASSERT_EQUAL_HEX32(held, keys.getState());
+    TEST_ASSERT_EQUAL_HEX32(0, scan(held, 20));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_press_is_taken_on_the_seventh_scan);
+    RUN_TEST(test_release_is_taken_on_the_seventh_scan);
+    RUN_TEST(test_glitch_mid_count_starts_the_count_again);
+    RUN_TEST(test_bouncing_key_never_changes);
+    RUN_TEST(test_two_keys_changing_on_the_same_scan);
+    RUN_TEST(test_keys_count_independently);
+    RUN_TEST(test_glitch_on_one_key_leaves_the_other_counting);
+    RUN_TEST(test_reset_takes_held_keys_without_changes);
+    return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+#include "quadrature.h"
+
+//pin samples as a | b << 1, one full detent each way
+const uint8_t FORWARD[] = { 2, 3, 1, 0 };
+const uint8_t BACKWARD[] = { 1, 3, 2, 0 };
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static int8_t sample(uint8_t &history, uint8_t pins) {
+    return quadratureStep(history, pins & 1, pins & 2);
+}
+
+void test_forward_detent_counts_up(void) {
+    uint8_t history = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_INT8(1, sample(history, FORWARD[i]));
+    }
+}
+
+void test_backward_detent_counts_down(void) {
+    uint8_t history = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_INT8(-1, sample(history, BACKWARD[i]));
+    }
+}
+
+void test_no_change_and_skipped_states_count_nothing(void) {
+    uint8_t history = 0;
+    TEST_ASSERT_EQUAL_INT8(0, sample(history, 0));
+    TEST_ASSERT_EQUAL_INT8(0, sample(history, 3)); //both pins changed between samples
+    TEST_ASSERT_EQUAL_INT8(0, sample(history, 3));
+    TEST_ASSERT_EQUAL_INT8(0, sample(history, 0));
+}
+
+void test_contact_bounce_cancels_out(void) {
+    uint8_t history = 0;
+    int steps = 0;
+    for (uint8_t i = 0; i < 9; i++) {
+        steps += sample(history, i & 1 ? 2 : 0);
+    }
+    TEST_ASSERT_EQUAL_INT(0, steps);
+}
+
+void test_detents_keep_the_remainder(void) {
+    int remainder = 0;
+    TEST_ASSERT_EQUAL_INT(1, takeDetents(remainder, 4));
+    TEST_ASSERT_EQUAL_INT(0, remainder);
+    TEST_ASSERT_EQUAL_INT(0, takeDetents(remainder, 3));
+    TEST_ASSERT_EQUAL_INT(1, takeDetents(remainder, 1));
+    TEST_ASSERT_EQUAL_INT(1, takeDetents(remainder, 7));
+    TEST_ASSERT_EQUAL_INT(3, remainder);
+    TEST_ASSERT_EQUAL_INT(-1, takeDetents(remainder, -8));
+    TEST_ASSERT_EQUAL_INT(-1, remainder);
+    TEST_ASSERT_EQUAL_INT(-1, takeDetents(remainder, -3));
+    TEST_ASSERT_EQUAL_INT(0, remainder);
+}
+
+void test_slow_turns_are_not_accelerated(void) {
+    TEST_ASSERT_EQUAL_UINT8(1, detentAcceleration(1, 1000));
+    TEST_ASSERT_EQUAL_UINT8(1, detentAcceleration(1, 125)); //ENCODER_ACCEL_SPEED detents per second
+    TEST_ASSERT_EQUAL_UINT8(1, detentAcceleration(-1, 125));
+}
+
+void test_fast_turns_are_accelerated_up_to_the_limit(void) {
+    TEST_ASSERT_EQUAL_UINT8(2, detentAcceleration(1, 62));
+    TEST_ASSERT_EQUAL_UINT8(2, detentAcceleration(-1, 62));
+    TEST_ASSERT_EQUAL_UINT8(4, detentAcceleration(2, 62));
+    TEST_ASSERT_EQUAL_UINT8(ENCODER_MAX_ACCEL, detentAcceleration(10, 10));
+    TEST_ASSERT_EQUAL_UINT8(ENCODER_MAX_ACCEL, detentAcceleration(1, 0)); //polled twice in one millisecond
+}
+
+void test_count_saturates_instead_of_wrapping(void) {
+    int8_t steps = 0;
+    for (int i = 0; i < 300; i++) steps = addSteps(steps, 1);
+    TEST_ASSERT_EQUAL_INT8(127, steps);
+    steps = addSteps(steps, -1);
+    TEST_ASSERT_EQUAL_INT8(126, steps);
+
+    steps = 0;
+    for (int i = 0; i < 300; i++) steps = addSteps(steps, -1);
+    TEST_ASSERT_EQUAL_INT8(-128, steps);
+}
+
+void test_fast_turn_through_a_long_poll_gap(void) {
+    //the timer samples at ~1 kHz while a save stalls the loop for 250 ms and the knob
+    //turns 60 detents, more transitions than an int8_t holds
+    uint8_t history = 0;
+    int8_t steps = 0;
+    for (int ms = 0; ms < 250; ms++) {
+        if (ms < 240) {
+            steps = addSteps(steps, sample(history, FORWARD[ms % 4]));
+        } else {
+            steps = addSteps(steps, sample(history, FORWARD[3])); //stopped on a detent
+        }
+    }
+    TEST_ASSERT_EQUAL_INT8(127, steps);
+
+    int remainder = 0;
+    int detents = takeDetents(remainder, steps);
+    TEST_ASSERT_EQUAL_INT(31, detents); //still the way it turned, as many as fit
+    TEST_ASSERT_EQUAL_UINT8(ENCODER_MAX_ACCEL, detentAcceleration(detents, 250));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_forward_detent_counts_up);
+    RUN_TEST(test_backward_detent_counts_down);
+    RUN_TEST(test_no_change_and_skipped_states_count_nothing);
+    RUN_TEST(test_contact_bounce_cancels_out);
+    RUN_TEST(test_detents_keep_the_remainder);
+    RUN_TEST(test_slow_turns_are_not_accelerated);
+    RUN_TEST(test_fast_turns_are_accelerated_up_to_the_limit);
+    RUN_TEST(test_count_saturates_instead_of_wrapping);
+    RUN_TEST(test_fast_turn_through_a_long_poll_gap);
+    return UNITY_END();
+}
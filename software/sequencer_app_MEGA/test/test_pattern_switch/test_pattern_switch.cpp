@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <SerialFlash.h>
+#include "sequencer.h"
+#include "memory.h"
+#include "pinout.h"
+
+//a patch picked by hand is read into the shadow banks while the current one plays,
+//and takes over on the next bar line without waiting on the flash
+
+const uint8_t NEXT_PATCH = 2;
+const uint8_t LENGTH = 32; //two bars, so the bar line isn't the end of the pattern
+const uint8_t BAR_LINE = 16;
+const uint8_t NEXT_PITCH = 7;
+
+Calibration calibration;
+Dac dac;
+Sequencer sequencer;
+Memory memory;
+
+bool switched = false;
+bool took_prefetched = false;
+host_flash_counters flash_at_switch;
+uint16_t dac_at_switch;
+uint8_t gate_at_switch;
+int step_at_switch;
+
+static sequence &seq() {
+    return *sequencer.getTrackSequence(0);
+}
+
+static void writePattern(int8_t pitch, bool bar_line_gate) {
+    sequencer.clearTrack(0);
+    seq().sequence_length = LENGTH;
+    seq().bars = LENGTH / 16;
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        seq().steps[i].gate = true;
+        seq().steps[i].pitch = pitch;
+    }
+    seq().steps[BAR_LINE].gate = bar_line_gate;
+}
+
+static void onStep() { //what Ui::onStepIncremented does for a queued patch
+    if (sequencer.timeForNextSequence()) {
+        flash_at_switch = host_flash;
+        took_prefetched = memory.takePrefetched(NEXT_PATCH);
+        sequencer.setActiveNote();
+        switched = true;
+        flash_at_switch.opens = host_flash.opens - flash_at_switch.opens;
+        flash_at_switch.reads = host_flash.reads - flash_at_switch.reads;
+        flash_at_switch.lookups = host_flash.lookups - flash_at_switch.lookups;
+        dac_at_switch = host_dac_value[0];
+        gate_at_switch = host_pins[GATE_PIN];
+        step_at_switch = sequencer.getCurrentStep();
+        return;
+    }
+    sequencer.setActiveNote();
+}
+
+static void run(uint32_t ms) { //the main loop, a pass per millisecond
+    for (uint32_t i = 0; i < ms && !switched; i++) {
+        hostAdvanceMillis(1);
+        sequencer.updateClock();
+        if (sequencer.stepWasIncremented()) onStep();
+        memory.pollPrefetch();
+    }
+}
+
+static void runToStep(int step) {
+    for (uint32_t i = 0; i < 100000 && sequencer.getCurrentStep() != step; i++) {
+        hostAdvanceMillis(1);
+        sequencer.updateClock();
+        if (sequencer.stepWasIncremented()) onStep();
+        memory.pollPrefetch();
+    }
+}
+
+void setUp(void) {
+    hostReset();
+    sequencer.init(calibration, dac);
+    memory.init(sequencer);
+    while (sequencer.getSwitchQuantize() != SWITCH_BAR) sequencer.cycleSwitchQuantize();
+    switched = false;
+    took_prefetched = false;
+
+    //the next patch plays NEXT_PITCH, and its first step after the bar line is on
+    writePattern(NEXT_PITCH, true);
+    TEST_ASSERT_TRUE(memory.save(NEXT_PATCH));
+    TEST_ASSERT_TRUE(memory.finishSaving());
+
+    //the playing one plays pitch 0 and rests on the bar line
+    writePattern(0, false);
+    sequencer.clearHistory();
+}
+
+void tearDown(void) {
+    if (sequencer.isRunning()) sequencer.onPlayButton();
+}
+
+void test_bar_line_switch_plays_from_the_shadow_bank(void) {
+    sequence *playing = &seq();
+    sequencer.onPlayButton();
+    runToStep(3);
+    uint16_t dac_before = host_dac_value[0];
+
+    TEST_ASSERT_TRUE(memory.prefetch(NEXT_PATCH));
+    sequencer.queueSequenceSwitch();
+    run(10000);
+
+    TEST_ASSERT_TRUE(switched);
+    TEST_ASSERT_TRUE(took_prefetched);
+    TEST_ASSERT_EQUAL_UINT32(0, flash_at_switch.opens);
+    TEST_ASSERT_EQUAL_UINT32(0, flash_at_switch.reads);
+    TEST_ASSERT_EQUAL_UINT32(0, flash_at_switch.lookups);
+
+    TEST_ASSERT_TRUE(&seq() != playing); //the banks swapped
+    TEST_ASSERT_EQUAL_INT(NEXT_PITCH, seq().steps[0].pitch);
+    TEST_ASSERT_EQUAL_INT(BAR_LINE, step_at_switch); //carries on from the same bar
+    TEST_ASSERT_EQUAL_UINT8(HIGH, gate_at_switch); //the new pattern's step, not the old rest
+    TEST_ASSERT_NOT_EQUAL(dac_before, dac_at_switch);
+    TEST_ASSERT_EQUAL_UINT16(calibration.getCalibratedOutput(3 * 12 + NEXT_PITCH, 0), dac_at_switch);
+}
+
+void test_prefetch_is_read_before_the_bar_line(void) {
+    sequencer.onPlayButton();
+    runToStep(3);
+    TEST_ASSERT_TRUE(memory.prefetch(NEXT_PATCH));
+    sequencer.queueSequenceSwitch();
+    runToStep(BAR_LINE - 1); //reading takes a part per loop pass, well within a bar
+
+    host_flash = host_flash_counters();
+    run(10000);
+    TEST_ASSERT_TRUE(switched);
+    TEST_ASSERT_EQUAL_UINT32(0, host_flash.opens);
+    TEST_ASSERT_EQUAL_UINT32(0, host_flash.reads);
+}
+
+void test_unfinished_prefetch_is_not_taken(void) {
+    sequencer.onPlayButton();
+    runToStep(3);
+    TEST_ASSERT_TRUE(memory.prefetch(NEXT_PATCH));
+    host_flash_busy = true; //a save erasing holds the reads off
+    sequencer.queueSequenceSwitch();
+    run(10000);
+
+    TEST_ASSERT_TRUE(switched);
+    TEST_ASSERT_FALSE(took_prefetched); //the ui loads it the slow way instead
+    TEST_ASSERT_EQUAL_INT(0, seq().steps[0].pitch);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bar_line_switch_plays_from_the_shadow_bank);
+    RUN_TEST(test_prefetch_is_read_before_the_bar_line);
+    RUN_TEST(test_unfinished_prefetch_is_not_taken);
+    return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include <unity.h>
+#include "prng.h"
+
+//patches store only the seed, so these streams must never change or saved
+//generative patterns would play differently after a firmware update
+
+const uint16_t DEFAULT_SEED_STREAM[] = { 0xD30F, 0xF1A5, 0x1734, 0xFF72, 0x1751, 0x318E, 0x03F5, 0xF009 };
+const uint8_t DEFAULT_SEED_RANGE_12[] = { 9, 11, 1, 11, 1, 2, 0, 11, 0, 11, 6, 6, 2, 3, 1, 0 };
+const bool DEFAULT_SEED_CHANCE_64[] = { 0, 0, 1, 0, 1, 1, 1, 0, 1, 0, 0, 0, 1, 0, 1, 1 };
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_next_from_default_seed(void) {
+    Prng prng;
+    prng.seed(PRNG_DEFAULT_SEED);
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_STREAM) / sizeof(DEFAULT_SEED_STREAM[0]); i++) {
+        TEST_ASSERT_EQUAL_HEX16(DEFAULT_SEED_STREAM[i], prng.next());
+    }
+}
+
+void test_unseeded_starts_at_default_seed(void) {
+    Prng prng;
+    TEST_ASSERT_EQUAL_HEX16(PRNG_DEFAULT_SEED, prng.getState());
+    TEST_ASSERT_EQUAL_HEX16(DEFAULT_SEED_STREAM[0], prng.next());
+}
+
+void test_zero_seed_plays_default_stream(void) {
+    Prng prng;
+    prng.seed(0);
+    TEST_ASSERT_EQUAL_HEX16(PRNG_DEFAULT_SEED, prng.getState());
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_STREAM) / sizeof(DEFAULT_SEED_STREAM[0]); i++) {
+        TEST_ASSERT_EQUAL_HEX16(DEFAULT_SEED_STREAM[i], prng.next());
+    }
+}
+
+void test_range_from_default_seed(void) {
+    Prng prng;
+    prng.seed(PRNG_DEFAULT_SEED);
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_RANGE_12); i++) {
+        TEST_ASSERT_EQUAL_UINT8(DEFAULT_SEED_RANGE_12[i], prng.range(12));
+    }
+}
+
+void test_chance_from_default_seed(void) {
+    Prng prng;
+    prng.seed(PRNG_DEFAULT_SEED);
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_CHANCE_64); i++) {
+        TEST_ASSERT_EQUAL(DEFAULT_SEED_CHANCE_64[i], prng.chance(64));
+    }
+}
+
+void test_zero_seed_range_and_chance(void) {
+    Prng prng;
+    prng.seed(0);
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_RANGE_12); i++) {
+        TEST_ASSERT_EQUAL_UINT8(DEFAULT_SEED_RANGE_12[i], prng.range(12));
+    }
+    prng.seed(0);
+    for (uint8_t i = 0; i < sizeof(DEFAULT_SEED_CHANCE_64); i++) {
+        TEST_ASSERT_EQUAL(DEFAULT_SEED_CHANCE_64[i], prng.chance(64));
+    }
+}
+
+void test_full_period_never_zero(void) {
+    Prng prng;
+    prng.seed(PRNG_DEFAULT_SEED);
+    uint32_t period = 0;
+    do {
+        TEST_ASSERT_NOT_EQUAL(0, prng.next());
+        period++;
+    } while (prng.getState() != PRNG_DEFAULT_SEED && period <= 65535);
+    TEST_ASSERT_EQUAL_UINT32(65535, period);
+}
+
+void test_range_and_chance_bounds(void) {
+    Prng prng;
+    prng.seed(PRNG_DEFAULT_SEED);
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < 65535; i++) {
+        TEST_ASSERT_LESS_THAN(255, prng.range(255));
+        TEST_ASSERT_EQUAL_UINT8(0, prng.range(1));
+        TEST_ASSERT_FALSE(prng.chance(0));
+        hits += prng.chance(128);
+    }
+    TEST_ASSERT_UINT_WITHIN(512, 32768, hits);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_next_from_default_seed);
+    RUN_TEST(test_unseeded_starts_at_default_seed);
+    RUN_TEST(test_zero_seed_plays_default_stream);
+    RUN_TEST(test_range_from_default_seed);
+    RUN_TEST(test_chance_from_default_seed);
+    RUN_TEST(test_zero_seed_range_and_chance);
+    RUN_TEST(test_full_period_never_zero);
+    RUN_TEST(test_range_and_chance_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <ctime>
+#include <cstdio>
+#include <unity.h>
+#include <Arduino.h>
+#include "sequencer.h"
+
+//work done per main loop pass with the second track off and on, counted in DAC writes
+//and reported in host time. TRACK_COUNT is fixed at one track per DAC channel, so
+//these two points are the whole sweep
+
+const uint32_t COUNTED_PASSES = 10000; //loop passes whose DAC writes are counted, a millisecond each
+const uint32_t TIMED_PASSES = 200000; //loop passes per timed run
+const uint8_t RUNS = 5; //the fastest run is kept, the others caught the host doing something else
+
+Calibration calibration;
+Dac dac;
+Sequencer sequencer;
+
+void setUp(void) {
+    hostReset();
+    sequencer.init(calibration, dac);
+}
+
+void tearDown(void) {
+    if (sequencer.isRunning()) sequencer.onPlayButton();
+}
+
+static void writePattern(uint8_t track_index) { //every step on and gliding, so each pass of a step's glide writes the DAC
+    sequence &seq = *sequencer.getTrackSequence(track_index);
+    for (uint8_t i = 0; i < seq.sequence_length; i++) {
+        seq.steps[i].gate = true;
+        seq.steps[i].glide = true;
+        seq.steps[i].pitch = (i * 5) % 24;
+    }
+}
+
+static void startTracks(bool second_track) {
+    writePattern(0);
+    writePattern(1);
+    if (second_track) { //from the panel, so its glide time is worked out too
+        sequencer.selectNextTrack();
+        sequencer.incrementDivision(1);
+        sequencer.selectNextTrack();
+    }
+    sequencer.onPlayButton();
+}
+
+static void runLoop(uint32_t passes) {
+    for (uint32_t i = 0; i < passes; i++) {
+        hostAdvanceMillis(1);
+        sequencer.updateClock();
+        if (sequencer.stepWasIncremented()) sequencer.setActiveNote();
+    }
+}
+
+static void countDacWrites(bool second_track, uint16_t *writes) { //over COUNTED_PASSES, the same on every host
+    setUp();
+    startTracks(second_track);
+    host_dac_writes[0] = host_dac_writes[1] = 0;
+    runLoop(COUNTED_PASSES);
+    writes[0] = host_dac_writes[0];
+    writes[1] = host_dac_writes[1];
+    tearDown();
+}
+
+static double nsPerPass(bool second_track) {
+    double best = 0;
+    for (uint8_t run = 0; run < RUNS; run++) {
+        setUp();
+        startTracks(second_track);
+        std::clock_t start = std::clock();
+        runLoop(TIMED_PASSES);
+        double ns = (std::clock() - start) * 1e9 / CLOCKS_PER_SEC / TIMED_PASSES;
+        if (run == 0 || ns < best) best = ns;
+        tearDown();
+    }
+    return best;
+}
+
+void test_second_track_adds_one_track_of_work(void) {
+    uint16_t one[2];
+    uint16_t two[2];
+    countDacWrites(false, one);
+    countDacWrites(true, two);
+    char message[128];
+    snprintf(message, sizeof(message), "DAC writes per %lu passes: 1 track %u + %u, 2 tracks %u + %u",
+        (unsigned long)COUNTED_PASSES, one[0], one[1], two[0], two[1]);
+    TEST_MESSAGE(message);
+
+    //both tracks glide through every step of the same pattern, so the second one
+    //adds exactly the first one's writes and leaves the first one's alone
+    TEST_ASSERT_GREATER_THAN(COUNTED_PASSES / 4, one[0]);
+    TEST_ASSERT_EQUAL_UINT16(one[0], two[0]);
+    TEST_ASSERT_EQUAL_UINT16(one[0], two[1]);
+    TEST_ASSERT_LESS_OR_EQUAL(2 * (one[0] + one[1]), two[0] + two[1]);
+}
+
+void test_report_time_per_pass(void) { //wall clock depends on the host, so it is only reported
+    double one = nsPerPass(false);
+    double two = nsPerPass(true);
+    char message[96];
+    snprintf(message, sizeof(message), "1 track %.1f ns/pass, 2 tracks %.1f ns/pass (x%.2f)", one, two, two / one);
+    TEST_MESSAGE(message);
+}
+
+void test_second_track_plays_in_the_benchmark(void) { //else the counts measure nothing
+    startTracks(true);
+    host_dac_writes[1] = 0;
+    uint16_t channel_1 = host_dac_value[1];
+    bool changed = false;
+    for (uint32_t i = 0; i < 2000; i++) {
+        runLoop(1);
+        if (host_dac_value[1] != channel_1) changed = true;
+    }
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(host_dac_writes[1] > 0);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_second_track_plays_in_the_benchmark);
+    RUN_TEST(test_second_track_adds_one_track_of_work);
+    RUN_TEST(test_report_time_per_pass);
+    return UNITY_END();
+}
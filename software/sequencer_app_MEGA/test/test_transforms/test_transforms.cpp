@@ -0,0 +1,375 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "sequencer.h"
+
+//the transforms of the edited track, on a chromatic 16-step pattern unless a test says otherwise
+
+const uint8_t LENGTH = 16;
+const bool MAJOR[12] = { 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1 };
+
+Calibration calibration;
+Dac dac;
+Sequencer sequencer;
+
+struct step_copy {
+    bool gate;
+    int note;
+    uint16_t duration;
+    int8_t cv;
+    uint8_t trig;
+};
+
+static sequence &seq() {
+    return *sequencer.getTrackSequence(0);
+}
+
+static int noteAt(uint8_t step) {
+    return seq().steps[step].octave * 12 + seq().steps[step].pitch;
+}
+
+static void writeNote(uint8_t step, int note) {
+    int pitch_class = (note % 12 + 12) % 12;
+    seq().steps[step].pitch = pitch_class;
+    seq().steps[step].octave = (note - pitch_class) / 12;
+}
+
+static step_copy copyStep(uint8_t step) {
+    step_data &s = seq().steps[step];
+    step_copy copy = { (bool)s.gate, noteAt(step), (uint16_t)s.duration, (int8_t)s.cv, seq().trig_matrix[step] };
+    return copy;
+}
+
+static void assertStep(const step_copy &expected, uint8_t step) {
+    step_copy actual = copyStep(step);
+    TEST_ASSERT_EQUAL(expected.gate, actual.gate);
+    TEST_ASSERT_EQUAL_INT(expected.note, actual.note);
+    TEST_ASSERT_EQUAL_UINT16(expected.duration, actual.duration);
+    TEST_ASSERT_EQUAL_INT8(expected.cv, actual.cv);
+    TEST_ASSERT_EQUAL_UINT8(expected.trig, actual.trig);
+}
+
+static void fillPattern() { //every lane different on every step
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        seq().steps[i].gate = i % 3 == 0;
+        writeNote(i, i - 4);
+        seq().steps[i].duration = 10 + i;
+        seq().steps[i].cv = i * 5;
+        seq().trig_matrix[i] = i;
+    }
+    sequencer.rebuildPitchPool();
+}
+
+static void pickPivot(uint8_t step) { //selecting an active step leaves it on
+    seq().steps[step].gate = true;
+    if (sequencer.getSelectedStep() != step) sequencer.selectStep(step);
+}
+
+void setUp(void) {
+    hostReset();
+    sequencer.init(calibration, dac);
+    sequencer.clearTrack(0);
+    sequencer.clearHistory();
+}
+
+void tearDown(void) {}
+
+void test_rotate_moves_every_lane_later(void) {
+    fillPattern();
+    step_copy before[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) before[i] = copyStep(i);
+
+    sequencer.rotateSequence(3);
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[i], (i + 3) % LENGTH);
+    }
+
+    sequencer.undo();
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[i], i);
+    }
+}
+
+void test_rotate_wraps_amounts_past_the_length(void) {
+    fillPattern();
+    step_copy before[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) before[i] = copyStep(i);
+
+    sequencer.rotateSequence(-LENGTH - 1);
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[(i + 1) % LENGTH], i);
+    }
+    sequencer.rotateSequence(LENGTH + 1);
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[i], i);
+    }
+}
+
+void test_rotate_keeps_a_short_lane_within_its_length(void) {
+    fillPattern();
+    seq().lane_length[LANE_PITCH] = 5;
+    int notes[LENGTH];
+    bool gates[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        notes[i] = noteAt(i);
+        gates[i] = seq().steps[i].gate;
+    }
+
+    sequencer.rotateSequence(1);
+    for (uint8_t i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[(i + 4) % 5], noteAt(i));
+    }
+    for (uint8_t i = 5; i < LENGTH; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[i], noteAt(i));
+    }
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        TEST_ASSERT_EQUAL(gates[(i + LENGTH - 1) % LENGTH], seq().steps[i].gate);
+    }
+}
+
+void test_reverse_plays_the_pattern_backwards(void) {
+    fillPattern();
+    step_copy before[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) before[i] = copyStep(i);
+
+    sequencer.reverseSequence();
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[LENGTH - 1 - i], i);
+    }
+    sequencer.reverseSequence();
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        assertStep(before[i], i);
+    }
+}
+
+void test_reverse_keeps_a_short_lane_within_its_length(void) {
+    fillPattern();
+    seq().lane_length[LANE_PITCH] = 5;
+    int notes[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) notes[i] = noteAt(i);
+
+    sequencer.reverseSequence();
+    for (uint8_t i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[4 - i], noteAt(i));
+    }
+    for (uint8_t i = 5; i < LENGTH; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[i], noteAt(i));
+    }
+}
+
+void test_locks_follow_their_steps(void) {
+    fillPattern();
+    sequencer.incrementLock(2, LOCK_TRANSPOSE, 1);
+    TEST_ASSERT_TRUE(sequencer.getLocked(2, LOCK_TRANSPOSE));
+
+    sequencer.rotateSequence(1);
+    TEST_ASSERT_FALSE(sequencer.getLocked(2, LOCK_TRANSPOSE));
+    TEST_ASSERT_TRUE(sequencer.getLocked(3, LOCK_TRANSPOSE));
+
+    sequencer.reverseSequence();
+    TEST_ASSERT_FALSE(sequencer.getLocked(3, LOCK_TRANSPOSE));
+    TEST_ASSERT_TRUE(sequencer.getLocked(LENGTH - 1 - 3, LOCK_TRANSPOSE));
+}
+
+void test_invert_mirrors_around_the_selected_step(void) {
+    writeNote(0, 4);
+    writeNote(1, 7);
+    writeNote(2, 0);
+    writeNote(3, 11);
+    writeNote(4, -5);
+    pickPivot(0);
+
+    sequencer.invertPitches();
+    TEST_ASSERT_EQUAL_INT(4, noteAt(0));
+    TEST_ASSERT_EQUAL_INT(1, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(8, noteAt(2));
+    TEST_ASSERT_EQUAL_INT(-3, noteAt(3));
+    TEST_ASSERT_EQUAL_INT(9, seq().steps[3].pitch); //stored as an in-scale pitch plus octave
+    TEST_ASSERT_EQUAL_INT(-1, seq().steps[3].octave);
+    TEST_ASSERT_EQUAL_INT(13, noteAt(4));
+
+    sequencer.undo(); //one entry for the whole transform
+    TEST_ASSERT_EQUAL_INT(7, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(0, noteAt(2));
+    TEST_ASSERT_EQUAL_INT(11, noteAt(3));
+    TEST_ASSERT_EQUAL_INT(-5, noteAt(4));
+}
+
+void test_invert_snaps_into_the_scale(void) {
+    sequencer.incrementScale(1); //major
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        writeNote(i, i);
+    }
+    pickPivot(4);
+
+    sequencer.invertPitches();
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        int mirrored = 8 - i;
+        TEST_ASSERT_TRUE(MAJOR[seq().steps[i].pitch % 12]);
+        TEST_ASSERT_INT_WITHIN(1, mirrored, noteAt(i));
+    }
+}
+
+void test_invert_clamps_to_the_octave_range(void) {
+    writeNote(0, 59);
+    writeNote(1, -48);
+    pickPivot(0);
+
+    sequencer.invertPitches();
+    TEST_ASSERT_EQUAL_INT(59, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(4, seq().steps[1].octave);
+}
+
+void test_transpose_moves_by_scale_degrees(void) {
+    sequencer.incrementScale(1); //major
+    writeNote(0, 0);
+    writeNote(1, 4);
+    writeNote(2, 11);
+    writeNote(3, 7);
+
+    sequencer.transposeInScale(1);
+    TEST_ASSERT_EQUAL_INT(2, noteAt(0));
+    TEST_ASSERT_EQUAL_INT(5, noteAt(1)); //E to F is a semitone
+    TEST_ASSERT_EQUAL_INT(12, noteAt(2)); //B to the next C
+    TEST_ASSERT_EQUAL_INT(0, seq().steps[2].pitch);
+    TEST_ASSERT_EQUAL_INT(1, seq().steps[2].octave);
+    TEST_ASSERT_EQUAL_INT(9, noteAt(3));
+
+    sequencer.transposeInScale(-2);
+    TEST_ASSERT_EQUAL_INT(-1, noteAt(0));
+    TEST_ASSERT_EQUAL_INT(2, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(9, noteAt(2));
+    TEST_ASSERT_EQUAL_INT(5, noteAt(3));
+
+    sequencer.transposeInScale(1);
+    TEST_ASSERT_EQUAL_INT(0, noteAt(0));
+    TEST_ASSERT_EQUAL_INT(4, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(11, noteAt(2));
+    TEST_ASSERT_EQUAL_INT(7, noteAt(3));
+}
+
+void test_transpose_by_an_octave_of_degrees(void) {
+    sequencer.incrementScale(1);
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        writeNote(i, i % 12 - (MAJOR[i % 12] ? 0 : 1)); //in scale
+    }
+    int notes[LENGTH];
+    for (uint8_t i = 0; i < LENGTH; i++) notes[i] = noteAt(i);
+
+    sequencer.transposeInScale(7);
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[i] + 12, noteAt(i));
+    }
+}
+
+void test_fold_brings_notes_into_the_pivot_octave(void) {
+    writeNote(0, 5);
+    writeNote(1, 26);
+    writeNote(2, 4);
+    writeNote(3, 17);
+    writeNote(4, -20);
+    pickPivot(0);
+
+    sequencer.foldOctaves();
+    TEST_ASSERT_EQUAL_INT(5, noteAt(0));
+    TEST_ASSERT_EQUAL_INT(14, noteAt(1));
+    TEST_ASSERT_EQUAL_INT(16, noteAt(2));
+    TEST_ASSERT_EQUAL_INT(5, noteAt(3));
+    TEST_ASSERT_EQUAL_INT(16, noteAt(4));
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(5, noteAt(i));
+        TEST_ASSERT_LESS_THAN(17, noteAt(i));
+    }
+}
+
+static void fillLongPattern() { //whole 128 steps, too many notes to journal one by one
+    seq().sequence_length = SEQUENCE_MAX_LENGTH;
+    seq().bars = SEQUENCE_MAX_LENGTH / 16;
+    for (uint8_t i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+        seq().steps[i].gate = i % 5 == 0;
+        writeNote(i, i % 29 - 10);
+    }
+    sequencer.rebuildPitchPool();
+}
+
+static void copyNotes(int *notes, bool *gates) {
+    for (uint8_t i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+        notes[i] = noteAt(i);
+        gates[i] = seq().steps[i].gate;
+    }
+}
+
+static void assertNotes(const int *notes, const bool *gates) {
+    for (uint8_t i = 0; i < SEQUENCE_MAX_LENGTH; i++) {
+        TEST_ASSERT_EQUAL_INT(notes[i], noteAt(i));
+        TEST_ASSERT_EQUAL(gates[i], seq().steps[i].gate);
+    }
+}
+
+void test_long_invert_and_fold_undo_without_losing_history(void) {
+    static int original[SEQUENCE_MAX_LENGTH], rotated[SEQUENCE_MAX_LENGTH], inverted[SEQUENCE_MAX_LENGTH];
+    static bool original_gates[SEQUENCE_MAX_LENGTH], rotated_gates[SEQUENCE_MAX_LENGTH], inverted_gates[SEQUENCE_MAX_LENGTH];
+    fillLongPattern();
+    pickPivot(0);
+    copyNotes(original, original_gates);
+    sequencer.rotateSequence(1);
+    copyNotes(rotated, rotated_gates);
+
+    sequencer.invertPitches();
+    copyNotes(inverted, inverted_gates);
+    TEST_ASSERT_NOT_EQUAL(rotated[1], inverted[1]);
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo());
+    assertNotes(rotated, rotated_gates);
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.redo());
+    assertNotes(inverted, inverted_gates);
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo());
+    assertNotes(rotated, rotated_gates);
+
+    sequencer.foldOctaves();
+    TEST_ASSERT_NOT_EQUAL(rotated[1], noteAt(1));
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo());
+    assertNotes(rotated, rotated_gates);
+
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo()); //the rotation before them is still there
+    assertNotes(original, original_gates);
+    TEST_ASSERT_EQUAL_UINT8(0, sequencer.undo());
+}
+
+void test_whole_sequence_euclid_sweep_undoes_as_one_fill(void) {
+    static int original[SEQUENCE_MAX_LENGTH], rotated[SEQUENCE_MAX_LENGTH];
+    static bool original_gates[SEQUENCE_MAX_LENGTH], rotated_gates[SEQUENCE_MAX_LENGTH];
+    fillLongPattern();
+    copyNotes(original, original_gates);
+    sequencer.rotateSequence(2);
+    copyNotes(rotated, rotated_gates);
+
+    for (uint8_t hits = 1; hits <= 40; hits++) { //an encoder sweep of the hits
+        sequencer.fillEuclid(0, SEQUENCE_MAX_LENGTH, hits, 0);
+    }
+    uint8_t hits = 0;
+    for (uint8_t i = 0; i < SEQUENCE_MAX_LENGTH; i++) hits += seq().steps[i].gate;
+    TEST_ASSERT_EQUAL_UINT8(40, hits);
+
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo());
+    assertNotes(rotated, rotated_gates);
+    TEST_ASSERT_NOT_EQUAL(0, sequencer.undo());
+    assertNotes(original, original_gates);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rotate_moves_every_lane_later);
+    RUN_TEST(test_rotate_wraps_amounts_past_the_length);
+    RUN_TEST(test_rotate_keeps_a_short_lane_within_its_length);
+    RUN_TEST(test_reverse_plays_the_pattern_backwards);
+    RUN_TEST(test_reverse_keeps_a_short_lane_within_its_length);
+    RUN_TEST(test_locks_follow_their_steps);
+    RUN_TEST(test_invert_mirrors_around_the_selected_step);
+    RUN_TEST(test_invert_snaps_into_the_scale);
+    RUN_TEST(test_invert_clamps_to_the_octave_range);
+    RUN_TEST(test_transpose_moves_by_scale_degrees);
+    RUN_TEST(test_transpose_by_an_octave_of_degrees);
+    RUN_TEST(test_fold_brings_notes_into_the_pivot_octave);
+    RUN_TEST(test_long_invert_and_fold_undo_without_losing_history);
+    RUN_TEST(test_whole_sequence_euclid_sweep_undoes_as_one_fill);
+    return UNITY_END();
+}